@@ -0,0 +1,240 @@
+#include "../ts_stack.hpp"
+#include "../ts_tuned_queue.hpp"
+#include "../ts_thread_pool.hpp"
+#include "../ts_priority_queue.hpp"
+#include "../ts_segmented_queue.hpp"
+
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <string>
+#include <cstring>
+#include <functional>
+#include <queue>
+
+// Every thread runs op_num push/pop pairs against one shared container.
+// Returns million operations per second.
+template < class Container >
+double measure_push_pop(int thread_num, int op_num) {
+    Container c;
+    std::atomic<bool> start = false;
+    std::vector<std::thread> threads;
+    for (int i = 0; i < thread_num; ++i) {
+        threads.emplace_back([&c, &start, op_num] {
+            while (!start)
+                std::this_thread::yield();
+            for (int j = 0; j < op_num; ++j) {
+                c.push(j);
+                c.pop();
+            }
+        });
+    }
+
+    auto begin = std::chrono::steady_clock::now();
+    start = true;
+    for (auto& t : threads)
+        t.join();
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - begin;
+    return 2.0 * thread_num * op_num / elapsed.count() / 1e6;
+}
+
+static const int thread_nums[] = { 1, 2, 4, 8, 16, 32, 64 };
+
+static void print_header(const char* title, std::initializer_list<const char*> columns) {
+    std::cout << "\n" << title << " (Mops/s)\n" << std::setw(8) << "threads";
+    for (auto column : columns)
+        std::cout << std::setw(16) << column;
+    std::cout << "\n";
+}
+
+static void bench_reclaim(int op_num) {
+    using namespace ts::lock_free;
+    using namespace ts::reclaim;
+
+    print_header("stack reclamation", { "ref_count", "hazard_pointer", "epoch" });
+    for (int n : thread_nums) {
+        std::cout << std::setw(8) << n << std::fixed << std::setprecision(2)
+                  << std::setw(16) << measure_push_pop<stack<int, ref_count>>(n, op_num)
+                  << std::setw(16) << measure_push_pop<stack<int, hazard_pointer>>(n, op_num)
+                  << std::setw(16) << measure_push_pop<stack<int, epoch>>(n, op_num) << std::endl;
+    }
+
+    print_header("queue reclamation", { "ref_count", "hazard_pointer", "epoch" });
+    for (int n : thread_nums) {
+        std::cout << std::setw(8) << n << std::fixed << std::setprecision(2)
+                  << std::setw(16) << measure_push_pop<queue<int, ref_count>>(n, op_num)
+                  << std::setw(16) << measure_push_pop<queue<int, hazard_pointer>>(n, op_num)
+                  << std::setw(16) << measure_push_pop<queue<int, epoch>>(n, op_num) << std::endl;
+    }
+}
+
+static void bench_stack(int op_num) {
+    print_header("stack contention", { "mutex", "ref_count", "pooled", "elimination" });
+    for (int n : thread_nums) {
+        std::cout << std::setw(8) << n << std::fixed << std::setprecision(2)
+                  << std::setw(16) << measure_push_pop<ts::stack<int>>(n, op_num)
+                  << std::setw(16) << measure_push_pop<ts::lock_free::stack<int>>(n, op_num)
+                  << std::setw(16) << measure_push_pop<ts::lock_free::pooled_stack<int>>(n, op_num)
+                  << std::setw(16) << measure_push_pop<ts::lock_free::elimination_stack<int>>(n, op_num)
+                  << std::endl;
+    }
+}
+
+static void bench_queue(int op_num) {
+    using namespace ts::lock_free;
+
+    print_header("queue contention", { "ref_count", "hazard_pointer", "segmented" });
+    for (int n : thread_nums) {
+        std::cout << std::setw(8) << n << std::fixed << std::setprecision(2)
+                  << std::setw(16) << measure_push_pop<queue<int>>(n, op_num)
+                  << std::setw(16) << measure_push_pop<queue<int, ts::reclaim::hazard_pointer>>(n, op_num)
+                  << std::setw(16) << measure_push_pop<segmented_queue<int>>(n, op_num)
+                  << std::endl;
+    }
+}
+
+// The pool we used to hand-roll: every worker blocks on one shared queue.
+class shared_queue_pool {
+private:
+    ts::fine_tuned::queue<std::function<void()>> _queue;
+    std::vector<std::thread> _threads;
+
+public:
+    explicit shared_queue_pool(std::size_t thread_num) {
+        for (std::size_t i = 0; i < thread_num; ++i) {
+            _threads.emplace_back([this] {
+                std::function<void()> task;
+                while (true) {
+                    _queue.wait_and_pop(task);
+                    if (!task)
+                        return;
+                    task();
+                }
+            });
+        }
+    }
+    ~shared_queue_pool() {
+        for (std::size_t i = 0; i < _threads.size(); ++i)
+            _queue.push(std::function<void()>());
+        for (auto& t : _threads)
+            t.join();
+    }
+
+    template < class F >
+    std::future<std::invoke_result_t<F>> submit(F f) {
+        typedef std::invoke_result_t<F> result_type;
+        auto work = std::make_shared<std::packaged_task<result_type()>>(std::move(f));
+        auto res = work->get_future();
+        _queue.push([work] { (*work)(); });
+        return res;
+    }
+};
+
+// Every task at depth > 0 spawns two children, like a recursive divide and
+// conquer. Returns million tasks per second.
+template < class Pool >
+double measure_fan_out(int thread_num, int depth) {
+    std::atomic<int> finished = 0;
+    int total = (1 << (depth + 1)) - 1;
+    auto begin = std::chrono::steady_clock::now();
+    {
+        Pool pool(thread_num);
+        std::function<void(int)> spawn = [&](int level) {
+            pool.submit([&, level] {
+                if (level > 0) {
+                    spawn(level - 1);
+                    spawn(level - 1);
+                }
+                ++finished;
+            });
+        };
+        spawn(depth);
+        while (finished < total)
+            std::this_thread::yield();
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - begin;
+    return total / elapsed.count() / 1e6;
+}
+
+static void bench_pool(int op_num) {
+    int depth = 1;
+    while ((2 << depth) < op_num)
+        ++depth;
+
+    print_header("thread pool fan-out", { "shared_queue", "work_stealing" });
+    for (int n : thread_nums) {
+        std::cout << std::setw(8) << n << std::fixed << std::setprecision(2)
+                  << std::setw(16) << measure_fan_out<shared_queue_pool>(n, depth)
+                  << std::setw(16) << measure_fan_out<ts::thread_pool>(n, depth)
+                  << std::endl;
+    }
+}
+
+// What we used to do for scheduling: a std::priority_queue behind a mutex.
+class mutex_priority_queue {
+private:
+    std::mutex _m;
+    std::priority_queue<int, std::vector<int>, std::greater<int>> _data;
+
+public:
+    void push(int item) {
+        std::lock_guard<std::mutex> l(_m);
+        _data.push(item);
+    }
+    void pop() {
+        std::lock_guard<std::mutex> l(_m);
+        if (!_data.empty())
+            _data.pop();
+    }
+};
+
+// QueueNum heaps, 0 means the default of two per hardware thread.
+template < std::size_t QueueNum >
+class relaxed_priority_queue {
+private:
+    ts::priority_queue<int> _queue;
+
+public:
+    relaxed_priority_queue(): _queue(QueueNum ? QueueNum : 2 * std::thread::hardware_concurrency()) { }
+    void push(int item) { _queue.push(item, item); }
+    void pop() {
+        int item;
+        _queue.try_pop_min(item);
+    }
+};
+
+static void bench_priority(int op_num) {
+    print_header("priority queue", { "mutex", "multi_queue(1)", "multi_queue(4)", "multi_queue" });
+    for (int n : thread_nums) {
+        std::cout << std::setw(8) << n << std::fixed << std::setprecision(2)
+                  << std::setw(16) << measure_push_pop<mutex_priority_queue>(n, op_num)
+                  << std::setw(16) << measure_push_pop<relaxed_priority_queue<1>>(n, op_num)
+                  << std::setw(16) << measure_push_pop<relaxed_priority_queue<4>>(n, op_num)
+                  << std::setw(16) << measure_push_pop<relaxed_priority_queue<0>>(n, op_num)
+                  << std::endl;
+    }
+}
+
+// Usage: ts_bench [suite] [op_num], suite is one of: all, reclaim, stack, queue,
+// pool, priority.
+int main(int argc, char* argv[]) {
+
+    const char* suite = argc > 1 ? argv[1] : "all";
+    int op_num = argc > 2 ? std::atoi(argv[2]) : 100000;
+    bool all = !std::strcmp(suite, "all");
+
+    if (all || !std::strcmp(suite, "reclaim"))
+        bench_reclaim(op_num);
+    if (all || !std::strcmp(suite, "stack"))
+        bench_stack(op_num);
+    if (all || !std::strcmp(suite, "queue"))
+        bench_queue(op_num);
+    if (all || !std::strcmp(suite, "pool"))
+        bench_pool(op_num);
+    if (all || !std::strcmp(suite, "priority"))
+        bench_priority(op_num);
+
+    return 0;
+}
@@ -0,0 +1,84 @@
+#include "../ts_async_queue.hpp"
+#include "../ts_thread_pool.hpp"
+
+#include <gtest/gtest.h>
+#include <iostream>
+#include <atomic>
+#include <thread>
+
+// Fire-and-forget coroutine, enough to drive the awaiters.
+struct detached_task {
+    struct promise_type {
+        detached_task get_return_object() { return {}; }
+        std::suspend_never initial_suspend() noexcept { return {}; }
+        std::suspend_never final_suspend() noexcept { return {}; }
+        void return_void() { }
+        void unhandled_exception() { std::terminate(); }
+    };
+};
+
+detached_task consume(ts::async_queue<int>& q, int count, std::atomic<long long>& sum,
+                      std::atomic<int>& finished) {
+    for (int i = 0; i < count; ++i)
+        sum += co_await q.pop();
+    ++finished;
+}
+
+TEST(ts_async_queue, inline_resume) {
+
+    ts::async_queue<int> q;
+    q.push(1);
+    int item;
+    ASSERT_TRUE(q.try_pop(item));
+    ASSERT_EQ(item, 1);
+    ASSERT_FALSE(q.try_pop(item));
+
+    // Items already queued are taken without suspending.
+    std::atomic<long long> sum = 0;
+    std::atomic<int> finished = 0;
+    q.push(1);
+    q.push(2);
+    consume(q, 2, sum, finished);
+    ASSERT_EQ(finished, 1);
+    ASSERT_EQ(sum, 3);
+
+    // Consumers park until push resumes them on this thread.
+    for (int i = 0; i < 100; ++i)
+        consume(q, 2, sum, finished);
+    ASSERT_EQ(q.waiter_num(), 100);
+    for (int i = 0; i < 200; ++i)
+        q.push(i);
+    ASSERT_EQ(finished, 101);
+    ASSERT_EQ(q.waiter_num(), 0);
+    ASSERT_TRUE(q.empty());
+    ASSERT_EQ(sum, 3 + 200 * 199 / 2);
+}
+
+TEST(ts_async_queue, executor) {
+
+    // Thousands of logical consumers multiplexed on two worker threads.
+    ts::thread_pool pool(2);
+    ts::async_queue<int> q([&pool](std::coroutine_handle<> h) {
+        pool.submit([h] { h.resume(); });
+    });
+
+    std::atomic<long long> sum = 0;
+    std::atomic<int> finished = 0;
+    for (int i = 0; i < 2000; ++i)
+        consume(q, 10, sum, finished);
+
+    std::vector<std::thread> producers;
+    for (int i = 0; i < 4; ++i) {
+        producers.emplace_back([&q, i] {
+            for (int j = 0; j < 5000; ++j)
+                q.push(i * 5000 + j);
+        });
+    }
+    for (auto& t : producers)
+        t.join();
+
+    while (finished < 2000)
+        std::this_thread::yield();
+    ASSERT_TRUE(q.empty());
+    ASSERT_EQ(sum.load(), 20000LL * 19999 / 2);
+}
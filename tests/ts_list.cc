@@ -0,0 +1,219 @@
+#include <gtest/gtest.h>
+
+#include "../ts_ordered_list.hpp"
+#include "../ts_lazy_list.hpp"
+#include "../ts_compact_list.hpp"
+
+#include <iostream>
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+TEST(ts_ordered_list, basic) {
+
+    ts::lock_free::ordered_list<int, std::string> l;
+    ASSERT_TRUE(l.empty());
+    ASSERT_FALSE(l.contains(1));
+    ASSERT_TRUE(l.get(1).empty());
+
+    ASSERT_TRUE(l.insert(3, "3"));
+    ASSERT_TRUE(l.insert(1, "1"));
+    ASSERT_TRUE(l.insert(2, "2"));
+    ASSERT_FALSE(l.insert(2, "two"));
+    ASSERT_EQ(l.size(), 3);
+    ASSERT_TRUE(l.contains(2));
+    ASSERT_EQ(l.get(2), "two");
+
+    // Kept in key order.
+    int expected = 1;
+    for (auto& item : l.get_list())
+        ASSERT_EQ(item.first, expected++);
+
+    ASSERT_TRUE(l.erase(2));
+    ASSERT_FALSE(l.erase(2));
+    ASSERT_FALSE(l.contains(2));
+    std::string value;
+    ASSERT_FALSE(l.get(2, value));
+    ASSERT_TRUE(l.get(3, value));
+    ASSERT_EQ(value, "3");
+    ASSERT_EQ(l.size(), 2);
+
+    l.clear();
+    ASSERT_TRUE(l.empty());
+}
+
+TEST(ts_ordered_list, multithreadrun) {
+
+    ts::lock_free::ordered_list<int, int> l;
+    std::atomic<bool> done = false;
+
+    // Even keys stay, odd keys are inserted and erased over and over.
+    for (int i = 0; i < 200; i += 2)
+        l.insert(i, i);
+
+    std::vector<std::thread> threads;
+    for (int i = 0; i < 4; ++i) {
+        threads.emplace_back([&l, i] {
+            for (int round = 0; round < 200; ++round) {
+                for (int k = 1 + 2 * i; k < 200; k += 8) {
+                    l.insert(k, round);
+                    l.insert(k, round + 1);
+                }
+                for (int k = 1 + 2 * i; k < 200; k += 8)
+                    ASSERT_TRUE(l.erase(k));
+            }
+        });
+    }
+    std::atomic<bool> missing = false;
+    std::thread reader([&l, &done, &missing] {
+        while (!done) {
+            for (int k = 0; k < 200; k += 2) {
+                if (!l.contains(k) || l.get(k) != k)
+                    missing = true;
+            }
+        }
+    });
+
+    for (auto& t : threads)
+        t.join();
+    done = true;
+    reader.join();
+
+    ASSERT_FALSE(missing.load());
+    ASSERT_EQ(l.size(), 100);
+    int expected = 0;
+    for (auto& item : l.get_list()) {
+        ASSERT_EQ(item.first, expected);
+        expected += 2;
+    }
+}
+
+TEST(ts_lazy_list, basic) {
+
+    typedef std::pair<int, std::string> item;
+    ts::lazy_list<item> l;
+    auto key_is = [](int key) {
+        return [key](const item& data) { return data.first == key; };
+    };
+
+    ASSERT_FALSE(l.find_first_if(key_is(1)));
+    l.push_back(item(1, "1"));
+    l.insert(key_is(2), item(2, "2"));
+    l.insert(key_is(1), item(1, "one"));
+    ASSERT_EQ(l.size(), 2);
+    ASSERT_EQ(l.find_first_if(key_is(1))->second, "one");
+    ASSERT_EQ(l.get_list().size(), 2u);
+
+    // Data handed out stays valid after the node is replaced or removed.
+    auto old = l.find_first_if(key_is(2));
+    l.insert(key_is(2), item(2, "two"));
+    l.remove_if(key_is(1));
+    ASSERT_EQ(old->second, "2");
+    ASSERT_EQ(l.find_first_if(key_is(2))->second, "two");
+    ASSERT_FALSE(l.find_first_if(key_is(1)));
+    ASSERT_EQ(l.size(), 1);
+
+    ts::lazy_list<item> moved(std::move(l));
+    ASSERT_EQ(moved.size(), 1);
+    ASSERT_EQ(l.size(), 0);
+    moved.clear();
+    ASSERT_EQ(moved.size(), 0);
+}
+
+TEST(ts_lazy_list, multithreadrun) {
+
+    typedef std::pair<int, int> item;
+    ts::lazy_list<item> l;
+    for (int k = 0; k < 100; ++k)
+        l.push_back(item(k, k));
+
+    // Writers keep replacing and re-adding keys, a reader must always find
+    // every key in [0, 50) which is only ever replaced, never removed.
+    std::atomic<bool> done = false;
+    std::atomic<bool> missing = false;
+    std::thread reader([&l, &done, &missing] {
+        while (!done) {
+            for (int k = 0; k < 50; ++k) {
+                if (!l.find_first_if([k](const item& data) { return data.first == k; }))
+                    missing = true;
+            }
+        }
+    });
+
+    std::vector<std::thread> writers;
+    for (int i = 0; i < 4; ++i) {
+        writers.emplace_back([&l, i] {
+            for (int round = 0; round < 200; ++round) {
+                for (int k = i; k < 100; k += 4)
+                    l.insert([k](const item& data) { return data.first == k; }, item(k, round));
+                for (int k = 50 + i; k < 100; k += 4)
+                    l.remove_if([k](const item& data) { return data.first == k; });
+                for (int k = 50 + i; k < 100; k += 4)
+                    l.insert([k](const item& data) { return data.first == k; }, item(k, round));
+            }
+        });
+    }
+    for (auto& t : writers)
+        t.join();
+    done = true;
+    reader.join();
+
+    ASSERT_FALSE(missing.load());
+    // No key got duplicated by racing inserts.
+    ASSERT_EQ(l.size(), 100);
+}
+
+template < class List >
+void run_compact_list() {
+
+    typedef std::pair<int, std::string> item;
+    List l;
+    auto key_is = [](int key) {
+        return [key](const item& data) { return data.first == key; };
+    };
+
+    ASSERT_FALSE(l.find_first_if(key_is(1)));
+    for (int k = 0; k < 10; ++k)
+        l.push_back(item(k, std::to_string(k)));
+    l.insert(key_is(3), item(3, "three"));
+    l.insert(key_is(10), item(10, "10"));
+    ASSERT_EQ(l.size(), 11);
+    ASSERT_EQ(l.find_first_if(key_is(3))->second, "three");
+    ASSERT_EQ(l.find_first_if(key_is(10))->second, "10");
+
+    l.remove_if([](const item& data) { return data.first % 2; });
+    ASSERT_EQ(l.size(), 6);
+    ASSERT_FALSE(l.find_first_if(key_is(3)));
+    for (auto& data : l.get_list())
+        ASSERT_EQ(data.first % 2, 0);
+
+    List moved(std::move(l));
+    ASSERT_EQ(moved.size(), 6);
+    ASSERT_EQ(l.size(), 0);
+    moved.clear();
+    ASSERT_EQ(moved.size(), 0);
+
+    // Racing inserts of the same keys never duplicate them.
+    std::vector<std::thread> threads;
+    for (int i = 0; i < 4; ++i) {
+        threads.emplace_back([&moved] {
+            for (int k = 0; k < 200; ++k)
+                moved.insert([k](const item& data) { return data.first == k; },
+                             item(k, std::to_string(k)));
+        });
+    }
+    threads.emplace_back([&moved] {
+        for (int k = 0; k < 200; k += 2)
+            moved.remove_if([k](const item& data) { return data.first == k + 1000; });
+    });
+    for (auto& t : threads)
+        t.join();
+    ASSERT_EQ(moved.size(), 200);
+}
+
+TEST(ts_compact_list, basic) {
+    run_compact_list<ts::compact_list<std::pair<int, std::string>>>();
+    run_compact_list<ts::compact_list<std::pair<int, std::string>, 1>>();
+    run_compact_list<ts::compact_list<std::pair<int, std::string>, 3>>();
+}
@@ -1,6 +1,12 @@
 #include <gtest/gtest.h>
 
+#include "../ts_map.hpp"
 #include "../ts_tuned_map.hpp"
+#include "../ts_lazy_list.hpp"
+#include "../ts_compact_list.hpp"
+#include "../ts_skiplist_map.hpp"
+
+#include <thread>
 
 TEST(ts_map, multithreadrun) {
 
@@ -81,4 +87,167 @@ TEST(ts_map, multithreadrun) {
     t4.join();
     t5.join();
     ASSERT_TRUE(m.empty());
-}
\ No newline at end of file
+}
+
+template < template < class > class List >
+void run_bucket_list() {
+
+    ts::fine_tuned::map<int, std::string, std::hash<int>, List> m;
+
+    std::vector<std::thread> threads;
+    for (int i = 0; i < 4; ++i) {
+        threads.emplace_back([&m, i] {
+            for (int k = i * 500; k < (i + 1) * 500; ++k)
+                m.insert(k, std::to_string(k));
+        });
+    }
+    threads.emplace_back([&m] {
+        for (int k = 0; k < 2000; ++k) {
+            if (m.find(k)) {
+                ASSERT_EQ(m.get(k), std::to_string(k));
+            }
+        }
+    });
+    for (auto& t : threads)
+        t.join();
+    ASSERT_EQ(m.size(), 2000);
+
+    m.insert(7, "seven");
+    ASSERT_EQ(m.get(7), "seven");
+    m.erase(7);
+    ASSERT_FALSE(m.find(7));
+    ASSERT_EQ(m.get_map().size(), 1999u);
+    m.clear();
+    ASSERT_TRUE(m.empty());
+}
+
+TEST(ts_map, lazy_list_buckets) {
+    run_bucket_list<ts::lazy_list>();
+}
+
+TEST(ts_map, compact_list_buckets) {
+    run_bucket_list<ts::compact_list>();
+}
+
+TEST(ts_map, skiplist_map) {
+
+    ts::lock_free::skiplist_map<int, std::string> m;
+    ASSERT_TRUE(m.empty());
+    ASSERT_TRUE(m.begin() == m.end());
+
+    for (int k = 0; k < 100; k += 2)
+        ASSERT_TRUE(m.insert(k, std::to_string(k)));
+    ASSERT_FALSE(m.insert(10, "ten"));
+    ASSERT_EQ(m.get(10), "ten");
+    ASSERT_EQ(m.get(11), "");
+    ASSERT_EQ(m.size(), 50);
+
+    ASSERT_EQ(m.lower_bound(11)->first, 12);
+    ASSERT_EQ(m.lower_bound(12)->first, 12);
+    ASSERT_EQ(m.upper_bound(12)->first, 14);
+    ASSERT_TRUE(m.lower_bound(99) == m.end());
+
+    int expected = 20;
+    for (auto it = m.lower_bound(20); it != m.end() && it->first < 30; ++it, expected += 2)
+        ASSERT_EQ(it->first, expected);
+    ASSERT_EQ(expected, 30);
+
+    ASSERT_TRUE(m.erase(12));
+    ASSERT_FALSE(m.erase(12));
+    ASSERT_EQ(m.lower_bound(11)->first, 14);
+    ASSERT_EQ(m.get_map().size(), 49u);
+    m.clear();
+    ASSERT_TRUE(m.empty());
+    ASSERT_TRUE(m.begin() == m.end());
+}
+
+TEST(ts_map, skiplist_map_multithread) {
+
+    ts::lock_free::skiplist_map<int, int> m;
+    // Even keys stay, odd keys come and go while scans run.
+    for (int k = 0; k < 2000; k += 2)
+        m.insert(k, k);
+
+    std::vector<std::thread> threads;
+    for (int i = 0; i < 3; ++i) {
+        threads.emplace_back([&m, i] {
+            for (int round = 0; round < 5; ++round) {
+                for (int k = 1 + 2 * i; k < 2000; k += 6)
+                    m.insert(k, k);
+                for (int k = 1 + 2 * i; k < 2000; k += 6)
+                    ASSERT_TRUE(m.erase(k));
+            }
+        });
+    }
+    threads.emplace_back([&m] {
+        for (int round = 0; round < 5; ++round) {
+            int last = -1;
+            int even = 0;
+            for (auto it = m.begin(); it != m.end(); ++it) {
+                ASSERT_LT(last, it->first);
+                ASSERT_EQ(it->first, it->second);
+                last = it->first;
+                even += it->first % 2 == 0;
+            }
+            ASSERT_EQ(even, 1000);
+        }
+    });
+    for (auto& t : threads)
+        t.join();
+
+    ASSERT_EQ(m.size(), 1000);
+    auto snapshot = m.get_map();
+    ASSERT_EQ(snapshot.size(), 1000u);
+    for (auto& item : snapshot)
+        ASSERT_EQ(item.first % 2, 0);
+}
+
+template < class Map >
+void run_growth() {
+
+    Map m(2);
+    ASSERT_EQ(m.bucket_count(), 2);
+
+    std::vector<std::thread> threads;
+    for (int i = 0; i < 4; ++i) {
+        threads.emplace_back([&m, i] {
+            for (int k = i * 1000; k < (i + 1) * 1000; ++k)
+                m.insert(k, k);
+            // Keys inserted earlier must stay visible while buckets move.
+            for (int k = i * 1000; k < (i + 1) * 1000; ++k)
+                ASSERT_EQ(m.get(k), k);
+            for (int k = i * 1000; k < (i + 1) * 1000; k += 2)
+                m.erase(k);
+        });
+    }
+    threads.emplace_back([&m] {
+        // Odd keys are never erased, once seen they have to stay.
+        for (int round = 0; round < 3; ++round) {
+            for (int k = 1; k < 4000; k += 2) {
+                if (m.find(k)) {
+                    ASSERT_EQ(m.get(k), k);
+                }
+            }
+        }
+    });
+    for (auto& t : threads)
+        t.join();
+
+    ASSERT_GT(m.bucket_count(), 500);
+    ASSERT_EQ(m.size(), 2000);
+    for (int k = 0; k < 4000; ++k)
+        ASSERT_EQ(m.find(k), k % 2 == 1);
+    auto snapshot = m.get_map();
+    ASSERT_EQ(snapshot.size(), 2000u);
+    m.clear();
+    ASSERT_TRUE(m.empty());
+}
+
+TEST(ts_map, growth) {
+    run_growth<ts::map<int, int>>();
+}
+
+TEST(ts_map, fine_tuned_growth) {
+    run_growth<ts::fine_tuned::map<int, int>>();
+    run_growth<ts::fine_tuned::map<int, int, std::hash<int>, ts::lazy_list>>();
+}
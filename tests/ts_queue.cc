@@ -1,10 +1,24 @@
 #include "../ts_quque.hpp"
 #include "../ts_tuned_queue.hpp"
+#include "../ts_ring_queue.hpp"
+#include "../ts_spsc_queue.hpp"
+#include "../ts_sharded_queue.hpp"
+#include "../ts_priority_queue.hpp"
+#include "../ts_segmented_queue.hpp"
+#include "../ts_eventfd.hpp"
+#include "../ts_shm_queue.hpp"
 
 #include <gtest/gtest.h>
 #include <iostream>
 #include <thread>
 
+#ifdef __linux__
+#include <sys/epoll.h>
+#include <sys/wait.h>
+#include <signal.h>
+#include <unistd.h>
+#endif
+
 // using ::testing::TestWithParam;
 // using ::testing::Values;
 
@@ -173,6 +187,137 @@ TEST(ts_fine_tuned_queue, multithreadrun) {
     ASSERT_TRUE(q.empty());
 }
 
+TEST(ts_fine_tuned_queue, bulk) {
+
+    ts::fine_tuned::queue<int> q;
+
+    std::vector<int> out;
+    ASSERT_EQ(q.try_pop_bulk(std::back_inserter(out), 10), 0u);
+    // Must not wait for an item it would not pop anyway.
+    ASSERT_EQ(q.wait_and_pop_bulk(std::back_inserter(out), 0), 0u);
+
+    std::vector<int> items = { 1, 2, 3, 4, 5 };
+    q.push_range(items.begin(), items.end());
+    q.push_range(items.begin(), items.begin());
+    ASSERT_EQ(q.size(), 5);
+
+    ASSERT_EQ(q.try_pop_bulk(std::back_inserter(out), 3), 3u);
+    ASSERT_EQ(out, std::vector<int>({ 1, 2, 3 }));
+    ASSERT_EQ(q.try_pop_bulk(std::back_inserter(out), 10), 2u);
+    ASSERT_EQ(out, items);
+    ASSERT_TRUE(q.empty());
+
+    std::vector<int> batch(100);
+    for (int i = 0; i < 100; ++i)
+        batch[i] = i;
+
+    std::thread t1([&q, &batch] {
+        for (int i = 0; i < 100; ++i)
+            q.push_range(batch.begin(), batch.end());
+    });
+
+    std::atomic<int> sum = 0;
+    std::atomic<int> popped = 0;
+    std::vector<std::thread> consumers;
+    for (int i = 0; i < 2; ++i) {
+        consumers.emplace_back([&] {
+            std::vector<int> got;
+            while (popped < 10000) {
+                got.clear();
+                if (!q.try_pop_bulk(std::back_inserter(got), 64))
+                    continue;
+                for (int v : got)
+                    sum += v;
+                popped += got.size();
+            }
+        });
+    }
+
+    t1.join();
+    for (auto& t : consumers)
+        t.join();
+    ASSERT_EQ(popped.load(), 10000);
+    ASSERT_EQ(sum.load(), 100 * 4950);
+    ASSERT_TRUE(q.empty());
+
+    out.clear();
+    std::thread t2([&q, &out] {
+        ASSERT_EQ(q.wait_and_pop_bulk(std::back_inserter(out), 8), 3u);
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    q.push_range(items.begin(), items.begin() + 3);
+    t2.join();
+    ASSERT_EQ(out, std::vector<int>({ 1, 2, 3 }));
+}
+
+TEST(ts_fine_tuned_pooled_queue, multithreadrun) {
+
+    ts::fine_tuned::pooled_queue<std::string> q;
+
+    q.push("test");
+    std::string str;
+    ASSERT_TRUE(q.try_pop(str));
+    ASSERT_TRUE(str == "test");
+    q.push("abc");
+    auto s_str = q.try_pop();
+    ASSERT_TRUE(s_str);
+    ASSERT_TRUE(s_str->compare("abc") == 0);
+    ASSERT_FALSE(q.try_pop());
+
+    std::thread t1([&q] {
+        for (int i = 0; i < 1000; ++i)
+            q.push("string index: " + std::to_string(i+100));
+    });
+
+    std::thread t2([&q] {
+        std::string str;
+        for (int i = 0; i < 500; ++i)
+            q.wait_and_pop(str);
+    });
+
+    std::thread t3([&q] {
+        for (int i = 0; i < 500; ++i) {
+            auto s_str = q.wait_and_pop();
+            ASSERT_TRUE(s_str);
+        }
+    });
+
+    t1.join();
+    t2.join();
+    t3.join();
+
+    ASSERT_TRUE(q.empty());
+    q.push("1");
+    q.push("2");
+    q.push("3");
+    ASSERT_TRUE(q.size() == 3);
+    q.clear();
+    ASSERT_TRUE(q.size() == 0);
+    ASSERT_TRUE(q.empty());
+}
+
+TEST(ts_fine_tuned_pooled_queue, recycle) {
+
+    ts::fine_tuned::pooled_queue<int> q;
+
+    for (int i = 0; i < 100; ++i)
+        q.push(i);
+    int item;
+    while (q.try_pop(item)) { }
+
+    // Nodes are recycled once the pool is warm.
+    auto allocated = q.allocated_node_num();
+    for (int round = 0; round < 100; ++round) {
+        for (int i = 0; i < 100; ++i)
+            q.push(i);
+        for (int i = 0; i < 100; ++i) {
+            ASSERT_TRUE(q.try_pop(item));
+            ASSERT_EQ(item, i);
+        }
+    }
+    ASSERT_EQ(q.allocated_node_num(), allocated);
+}
+
 TEST(ts_fine_tuned_queue, multithreadrun_log) {
 
     ts::fine_tuned::queue<std::string> q;
@@ -226,4 +371,815 @@ TEST(ts_fine_tuned_queue, multithreadrun_log) {
     t1.join();
     t2.join();
     t3.join();
-}
\ No newline at end of file
+}
+
+TEST(ts_ring_queue, multithreadrun) {
+
+    ts::lock_free::ring_queue<std::string> q(100);
+    ASSERT_EQ(q.capacity(), 128);
+
+    q.push("test");
+    std::string str;
+    ASSERT_TRUE(q.try_pop(str));
+    ASSERT_TRUE(str == "test");
+    q.push("abc");
+    auto s_str = q.try_pop();
+    ASSERT_TRUE(s_str);
+    ASSERT_TRUE(s_str->compare("abc") == 0);
+    ASSERT_FALSE(q.try_pop());
+
+    for (int i = 0; i < 128; ++i)
+        ASSERT_TRUE(q.try_push(std::to_string(i)));
+    ASSERT_FALSE(q.try_push("full"));
+    ASSERT_EQ(q.size(), 128);
+    while (q.try_pop(str)) { }
+    ASSERT_TRUE(q.empty());
+
+    std::atomic<long long> sum = 0;
+    std::vector<std::thread> threads;
+    for (int i = 0; i < 4; ++i) {
+        threads.emplace_back([&q, i] {
+            for (int j = 0; j < 10000; ++j)
+                q.push(std::to_string(i * 10000 + j));
+        });
+    }
+    for (int i = 0; i < 4; ++i) {
+        threads.emplace_back([&q, &sum] {
+            std::string item;
+            for (int j = 0; j < 10000; ++j) {
+                q.wait_and_pop(item);
+                sum += std::stoi(item);
+            }
+        });
+    }
+
+    for (auto& t : threads)
+        t.join();
+
+    ASSERT_TRUE(q.empty());
+    ASSERT_EQ(sum.load(), 40000LL * 39999 / 2);
+}
+
+TEST(ts_spsc_queue, multithreadrun) {
+
+    ts::spsc_queue<int> q(1000);
+    ASSERT_EQ(q.capacity(), 1024);
+
+    std::vector<int> items(1500);
+    for (int i = 0; i < 1500; ++i)
+        items[i] = i;
+    ASSERT_EQ(q.push_n(items.begin(), items.size()), 1024);
+    ASSERT_FALSE(q.try_push(0));
+
+    std::vector<int> out;
+    ASSERT_EQ(q.pop_n(std::back_inserter(out), 2000), 1024);
+    ASSERT_EQ(out.back(), 1023);
+    ASSERT_TRUE(q.empty());
+
+    const int count = 200000;
+    std::thread producer([&q] {
+        std::vector<int> batch(64);
+        for (int i = 0; i < count;) {
+            int n = std::min<int>(batch.size(), count - i);
+            for (int j = 0; j < n; ++j)
+                batch[j] = i + j;
+            int pushed = 0;
+            while (pushed < n)
+                pushed += q.push_n(batch.begin() + pushed, n - pushed);
+            i += n;
+        }
+    });
+
+    std::thread consumer([&q] {
+        int expected = 0;
+        int item;
+        std::vector<int> batch;
+        while (expected < count) {
+            if (expected % 2) {
+                q.wait_and_pop(item);
+                ASSERT_EQ(item, expected++);
+            }
+            else {
+                batch.clear();
+                q.pop_n(std::back_inserter(batch), 32);
+                for (int value : batch)
+                    ASSERT_EQ(value, expected++);
+            }
+        }
+    });
+
+    producer.join();
+    consumer.join();
+    ASSERT_TRUE(q.empty());
+}
+
+// Copying throws once copies_left runs out; live counts constructed objects.
+struct throwing_copy {
+    static int live;
+    static int copies_left;
+    int value;
+
+    throwing_copy(int v): value(v) { ++live; }
+    throwing_copy(const throwing_copy& other): value(other.value) {
+        if (copies_left-- == 0)
+            throw std::runtime_error("copy");
+        ++live;
+    }
+    throwing_copy(throwing_copy&& other) noexcept: value(other.value) { ++live; }
+    throwing_copy& operator=(const throwing_copy&) = default;
+    throwing_copy& operator=(throwing_copy&&) = default;
+    ~throwing_copy() { --live; }
+};
+int throwing_copy::live = 0;
+int throwing_copy::copies_left = 0;
+
+TEST(ts_spsc_queue, throwingcopy) {
+
+    ts::spsc_queue<throwing_copy> q(8);
+    {
+        std::vector<throwing_copy> items;
+        for (int i = 0; i < 6; ++i)
+            items.emplace_back(i);
+
+        // The fourth copy throws, the three built before it are dropped.
+        throwing_copy::copies_left = 3;
+        ASSERT_THROW(q.push_n(items.begin(), items.size()), std::runtime_error);
+        ASSERT_TRUE(q.empty());
+        ASSERT_EQ(throwing_copy::live, 6);
+
+        throwing_copy::copies_left = -1;
+        ASSERT_EQ(q.push_n(items.begin(), items.size()), 6u);
+        ASSERT_EQ(throwing_copy::live, 12);
+    }
+
+    // Writing the third item throws, the first two are popped.
+    std::vector<int> out;
+    auto sink = [&out](const throwing_copy& item) {
+        if (out.size() == 2)
+            throw std::runtime_error("out");
+        out.push_back(item.value);
+    };
+    struct output {
+        decltype(sink)* f;
+        output& operator*() { return *this; }
+        output& operator++(int) { return *this; }
+        output& operator=(throwing_copy&& item) { (*f)(item); return *this; }
+    };
+    ASSERT_THROW(q.pop_n(output{ &sink }, 6), std::runtime_error);
+    ASSERT_EQ(out.size(), 2u);
+    ASSERT_EQ(q.size(), 4);
+
+    throwing_copy item(0);
+    for (int i = 2; i < 6; ++i) {
+        ASSERT_TRUE(q.try_pop(item));
+        ASSERT_EQ(item.value, i);
+    }
+    ASSERT_TRUE(q.empty());
+    ASSERT_EQ(throwing_copy::live, 1);
+}
+
+template < class Reclaimer >
+void run_reclaimed_queue() {
+
+    ts::lock_free::queue<std::string, Reclaimer> q;
+    ASSERT_TRUE(q.empty());
+    ASSERT_FALSE(q.pop());
+
+    q.push("1");
+    q.push("2");
+    ASSERT_FALSE(q.empty());
+    ASSERT_EQ(*q.pop(), "1");
+    ASSERT_EQ(*q.pop(), "2");
+    ASSERT_TRUE(q.empty());
+
+    std::atomic<long long> sum = 0;
+    std::atomic<int> popped = 0;
+    std::vector<std::thread> threads;
+    for (int i = 0; i < 4; ++i) {
+        threads.emplace_back([&q, i] {
+            for (int j = 0; j < 10000; ++j)
+                q.push(std::to_string(i * 10000 + j));
+        });
+    }
+    for (int i = 0; i < 4; ++i) {
+        threads.emplace_back([&q, &sum, &popped] {
+            while (popped < 40000) {
+                if (auto item = q.pop()) {
+                    sum += std::stoi(*item);
+                    ++popped;
+                }
+            }
+        });
+    }
+
+    for (auto& t : threads)
+        t.join();
+
+    // Leave a few items for the destructor.
+    q.push("3");
+    q.push("4");
+    ASSERT_EQ(sum.load(), 40000LL * 39999 / 2);
+}
+
+TEST(ts_lock_free_queue, ref_count) {
+
+    ts::lock_free::queue<std::string> q;
+    ASSERT_FALSE(q.pop());
+    q.push("1");
+    q.push("2");
+    ASSERT_EQ(*q.pop(), "1");
+    ASSERT_EQ(*q.pop(), "2");
+    ASSERT_FALSE(q.pop());
+
+    // The head's external count is 16 bits wide, polling an empty queue must
+    // not run it up (the node would leak once the count wrapped).
+    for (int i = 0; i < 70000; ++i)
+        ASSERT_FALSE(q.pop());
+    q.push("3");
+    ASSERT_EQ(*q.pop(), "3");
+}
+
+TEST(ts_lock_free_queue, hazard_pointer) {
+    run_reclaimed_queue<ts::reclaim::hazard_pointer>();
+}
+
+TEST(ts_lock_free_queue, epoch) {
+    run_reclaimed_queue<ts::reclaim::epoch>();
+}
+
+TEST(ts_sharded_queue, multithreadrun) {
+
+    ts::sharded_queue<int> q(4);
+    ASSERT_EQ(q.lane_num(), 4);
+    ASSERT_FALSE(q.try_pop());
+
+    // Items from a single producer keep their order.
+    for (int i = 0; i < 100; ++i)
+        q.push(i);
+    ASSERT_EQ(q.size(), 100);
+    int item;
+    for (int i = 0; i < 100; ++i) {
+        ASSERT_TRUE(q.try_pop(item));
+        ASSERT_EQ(item, i);
+    }
+    ASSERT_TRUE(q.empty());
+
+    std::atomic<long long> sum = 0;
+    std::vector<std::thread> threads;
+    for (int i = 0; i < 4; ++i) {
+        threads.emplace_back([&q, &sum] {
+            int item;
+            for (int j = 0; j < 10000; ++j) {
+                if (j % 2)
+                    q.wait_and_pop(item);
+                else
+                    item = *q.wait_and_pop();
+                sum += item;
+            }
+        });
+    }
+    for (int i = 0; i < 8; ++i) {
+        threads.emplace_back([&q, i] {
+            for (int j = 0; j < 5000; ++j)
+                q.push(i * 5000 + j);
+        });
+    }
+
+    for (auto& t : threads)
+        t.join();
+    ASSERT_TRUE(q.empty());
+    ASSERT_EQ(sum.load(), 40000LL * 39999 / 2);
+}
+
+template < class Queue >
+void run_spin_then_park_queue() {
+
+    Queue q;
+    std::atomic<long long> sum = 0;
+    std::vector<std::thread> threads;
+    for (int i = 0; i < 2; ++i) {
+        threads.emplace_back([&q, &sum] {
+            int item;
+            for (int j = 0; j < 10000; ++j) {
+                q.wait_and_pop(item);
+                sum += item;
+            }
+        });
+    }
+    for (int i = 0; i < 4; ++i) {
+        threads.emplace_back([&q, i] {
+            // Let the consumers run out of spins and park now and then.
+            for (int j = 0; j < 5000; ++j) {
+                if (j % 1000 == 0)
+                    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                q.push(i * 5000 + j);
+            }
+        });
+    }
+
+    for (auto& t : threads)
+        t.join();
+    ASSERT_TRUE(q.empty());
+    ASSERT_EQ(sum.load(), 20000LL * 19999 / 2);
+}
+
+TEST(ts_wait_policy, spin_then_park) {
+    typedef ts::wait::spin_then_park<> policy;
+    run_spin_then_park_queue<ts_queue<int, policy>>();
+    run_spin_then_park_queue<ts::fine_tuned::queue<int, policy>>();
+    run_spin_then_park_queue<ts::fine_tuned::pooled_queue<int, policy>>();
+    run_spin_then_park_queue<ts::fine_tuned::queue<int, ts::wait::spin_then_park<0>>>();
+}
+
+template < class Queue >
+void run_bounded_queue() {
+
+    Queue q(4);
+    ASSERT_EQ(q.capacity(), 4);
+    for (int i = 0; i < 4; ++i)
+        ASSERT_TRUE(q.try_push(i));
+    ASSERT_FALSE(q.try_push(4));
+    ASSERT_FALSE(q.push_for(4, std::chrono::milliseconds(10)));
+    ASSERT_EQ(q.size(), 4);
+
+    int item;
+    for (int i = 0; i < 4; ++i) {
+        ASSERT_TRUE(q.pop_for(item, std::chrono::milliseconds(10)));
+        ASSERT_EQ(item, i);
+    }
+    ASSERT_FALSE(q.pop_for(item, std::chrono::milliseconds(10)));
+    ASSERT_FALSE(q.pop_for(std::chrono::milliseconds(10)));
+    ASSERT_TRUE(q.empty());
+
+    // The queue never holds more than its capacity.
+    std::atomic<long long> sum = 0;
+    std::atomic<bool> overflow = false;
+    std::vector<std::thread> threads;
+    for (int i = 0; i < 4; ++i) {
+        threads.emplace_back([&q, i] {
+            for (int j = 0; j < 5000; ++j)
+                q.wait_and_push(i * 5000 + j);
+        });
+    }
+    for (int i = 0; i < 2; ++i) {
+        threads.emplace_back([&q, &sum, &overflow] {
+            int item;
+            for (int j = 0; j < 10000; ++j) {
+                if (q.size() > 4)
+                    overflow = true;
+                if (j % 2)
+                    q.wait_and_pop(item);
+                else
+                    item = *q.wait_and_pop();
+                sum += item;
+            }
+        });
+    }
+    for (auto& t : threads)
+        t.join();
+    ASSERT_FALSE(overflow.load());
+    ASSERT_TRUE(q.empty());
+    ASSERT_EQ(sum.load(), 20000LL * 19999 / 2);
+
+    // close() releases blocked consumers and producers.
+    std::thread consumer([&q] {
+        int item;
+        ASSERT_FALSE(q.wait_and_pop(item));
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    q.close();
+    consumer.join();
+    ASSERT_TRUE(q.closed());
+    ASSERT_FALSE(q.try_push(1));
+    ASSERT_FALSE(q.wait_and_pop());
+
+    Queue full(1);
+    ASSERT_TRUE(full.wait_and_push(1));
+    std::thread producer([&full] {
+        ASSERT_FALSE(full.wait_and_push(2));
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    full.close();
+    producer.join();
+    // Items pushed before close() can still be drained.
+    ASSERT_EQ(*full.wait_and_pop(), 1);
+    ASSERT_FALSE(full.wait_and_pop());
+}
+
+TEST(ts_bounded_queue, multithreadrun) {
+    run_bounded_queue<ts_bounded_queue<int>>();
+}
+
+TEST(ts_fine_tuned_bounded_queue, multithreadrun) {
+    run_bounded_queue<ts::fine_tuned::bounded_queue<int>>();
+}
+
+TEST(ts_priority_queue, exact) {
+
+    // A single heap pops in exact priority order.
+    ts::priority_queue<std::string> q(1);
+    ASSERT_FALSE(q.try_pop_min());
+    int priorities[] = { 5, 3, 9, 1, 7, 3, 0 };
+    for (int p : priorities)
+        q.push(p, std::to_string(p));
+    ASSERT_EQ(q.size(), 7);
+
+    std::string item;
+    int last = -1;
+    while (q.try_pop_min(item)) {
+        ASSERT_LE(last, std::stoi(item));
+        last = std::stoi(item);
+    }
+    ASSERT_EQ(last, 9);
+    ASSERT_TRUE(q.empty());
+
+    ts::priority_queue<int, int, std::greater<int>> max_q(1);
+    max_q.push(1, 1);
+    max_q.push(2, 2);
+    ASSERT_EQ(*max_q.try_pop_min(), 2);
+}
+
+TEST(ts_priority_queue, multithreadrun) {
+
+    ts::priority_queue<int> q(8);
+    ASSERT_EQ(q.queue_num(), 8);
+
+    std::atomic<long long> sum = 0;
+    std::vector<std::thread> threads;
+    for (int i = 0; i < 4; ++i) {
+        threads.emplace_back([&q, &sum] {
+            int item;
+            for (int j = 0; j < 10000; ++j) {
+                if (j % 2)
+                    q.wait_and_pop(item);
+                else
+                    item = *q.wait_and_pop();
+                sum += item;
+            }
+        });
+    }
+    for (int i = 0; i < 8; ++i) {
+        threads.emplace_back([&q, i] {
+            for (int j = 0; j < 5000; ++j)
+                q.push(j, i * 5000 + j);
+        });
+    }
+
+    for (auto& t : threads)
+        t.join();
+    ASSERT_TRUE(q.empty());
+    ASSERT_FALSE(q.try_pop_min());
+    ASSERT_EQ(sum.load(), 40000LL * 39999 / 2);
+}
+
+TEST(ts_segmented_queue, multithreadrun) {
+
+    // Tiny segments so that the test keeps appending and retiring them.
+    ts::lock_free::segmented_queue<std::string, 4> q;
+    ASSERT_TRUE(q.empty());
+    ASSERT_FALSE(q.pop());
+
+    for (int i = 0; i < 10; ++i)
+        q.push(std::to_string(i));
+    ASSERT_FALSE(q.empty());
+    std::string item;
+    for (int i = 0; i < 10; ++i) {
+        ASSERT_TRUE(q.try_pop(item));
+        ASSERT_EQ(item, std::to_string(i));
+    }
+    ASSERT_TRUE(q.empty());
+    ASSERT_FALSE(q.try_pop(item));
+
+    std::atomic<long long> sum = 0;
+    std::atomic<int> popped = 0;
+    std::vector<std::thread> threads;
+    for (int i = 0; i < 4; ++i) {
+        threads.emplace_back([&q, i] {
+            for (int j = 0; j < 10000; ++j)
+                q.push(std::to_string(i * 10000 + j));
+        });
+    }
+    for (int i = 0; i < 4; ++i) {
+        threads.emplace_back([&q, &sum, &popped] {
+            while (popped < 40000) {
+                if (auto item = q.pop()) {
+                    sum += std::stoi(*item);
+                    ++popped;
+                }
+            }
+        });
+    }
+
+    for (auto& t : threads)
+        t.join();
+    ASSERT_TRUE(q.empty());
+    ASSERT_EQ(sum.load(), 40000LL * 39999 / 2);
+
+    // Leave a few items, some in a second segment, for the destructor.
+    for (int i = 0; i < 6; ++i)
+        q.push(std::to_string(i));
+}
+
+struct counting_notifier {
+    int notified = 0;
+    int cleared = 0;
+    void notify() { ++notified; }
+    void clear() { ++cleared; }
+};
+
+TEST(ts_wait_policy, readiness) {
+
+    // Notifications coalesce until the consumer acks.
+    ts::fine_tuned::queue<int, ts::wait::readiness<counting_notifier>> q;
+    auto& policy = q.wait_policy();
+    q.push(1);
+    q.push(2);
+    std::vector<int> items = { 3, 4 };
+    q.push_range(items.begin(), items.end());
+    ASSERT_EQ(policy.notifier().notified, 1);
+
+    policy.ack();
+    int item;
+    while (q.try_pop(item));
+    ASSERT_EQ(policy.notifier().cleared, 1);
+    q.push(5);
+    ASSERT_EQ(policy.notifier().notified, 2);
+
+    // Blocking consumers still work.
+    ts_queue<int, ts::wait::readiness<counting_notifier>> blocking_q;
+    std::thread t([&blocking_q] {
+        ASSERT_EQ(*blocking_q.wait_and_pop(), 1);
+    });
+    blocking_q.push(1);
+    t.join();
+    ASSERT_EQ(blocking_q.wait_policy().notifier().notified, 1);
+}
+
+#ifdef __linux__
+TEST(ts_wait_policy, eventfd) {
+
+    ts::fine_tuned::queue<int, ts::wait::readiness<ts::eventfd_notifier>> q;
+    int ep = epoll_create1(EPOLL_CLOEXEC);
+    ASSERT_GE(ep, 0);
+    epoll_event ev = {};
+    ev.events = EPOLLIN;
+    ASSERT_EQ(epoll_ctl(ep, EPOLL_CTL_ADD, q.wait_policy().notifier().fd(), &ev), 0);
+
+    epoll_event out;
+    ASSERT_EQ(epoll_wait(ep, &out, 1, 0), 0);
+    q.push(1);
+    ASSERT_EQ(epoll_wait(ep, &out, 1, 0), 1);
+    q.wait_policy().ack();
+    ASSERT_EQ(epoll_wait(ep, &out, 1, 0), 0);
+    int item;
+    ASSERT_TRUE(q.try_pop(item));
+    ASSERT_FALSE(q.try_pop(item));
+
+    // An event loop drains items from several producers.
+    std::vector<std::thread> producers;
+    for (int i = 0; i < 4; ++i) {
+        producers.emplace_back([&q, i] {
+            for (int j = 0; j < 5000; ++j)
+                q.push(i * 5000 + j);
+        });
+    }
+
+    long long sum = 0;
+    int popped = 0;
+    while (popped < 20000) {
+        if (epoll_wait(ep, &out, 1, 1000) != 1)
+            break;
+        q.wait_policy().ack();
+        while (q.try_pop(item)) {
+            sum += item;
+            ++popped;
+        }
+    }
+    for (auto& t : producers)
+        t.join();
+    close(ep);
+    ASSERT_EQ(popped, 20000);
+    ASSERT_EQ(sum, 20000LL * 19999 / 2);
+}
+#endif
+
+TEST(ts_selector, priority) {
+
+    ts::fine_tuned::queue<std::string> control, data;
+    ts::selector<ts::fine_tuned::queue<std::string>> sel({ &control, &data });
+    ASSERT_EQ(sel.size(), 2);
+
+    std::string item;
+    ASSERT_EQ(sel.try_pop(item), sel.npos);
+    data.push("d1");
+    data.push("d2");
+    control.push("c1");
+    ASSERT_EQ(sel.try_pop(item), 0);
+    ASSERT_EQ(item, "c1");
+    ASSERT_EQ(sel.wait_and_pop(item), 1);
+    ASSERT_EQ(item, "d1");
+
+    // Round robin alternates between non-empty queues.
+    ts::fine_tuned::queue<int> a, b;
+    ts::selector<ts::fine_tuned::queue<int>> rr({ &a, &b }, ts::select_order::round_robin);
+    for (int i = 0; i < 3; ++i) {
+        a.push(i);
+        b.push(i);
+    }
+    int value;
+    for (int i = 0; i < 6; ++i)
+        ASSERT_EQ(rr.try_pop(value), static_cast<std::size_t>(i % 2));
+}
+
+TEST(ts_selector, multithreadrun) {
+
+    std::vector<std::unique_ptr<ts::fine_tuned::queue<int>>> queues;
+    std::vector<ts::fine_tuned::queue<int>*> sources;
+    for (int i = 0; i < 4; ++i) {
+        queues.emplace_back(new ts::fine_tuned::queue<int>);
+        sources.push_back(queues.back().get());
+    }
+
+    std::vector<long long> sums(4);
+    std::thread consumer([&sources, &sums] {
+        // One thread serves all four queues.
+        ts::selector<ts::fine_tuned::queue<int>> sel(sources, ts::select_order::round_robin);
+        int item;
+        for (int i = 0; i < 20000; ++i) {
+            std::size_t index = sel.wait_and_pop(item);
+            ASSERT_LT(index, 4u);
+            sums[index] += item;
+        }
+    });
+
+    std::vector<std::thread> producers;
+    for (int i = 0; i < 4; ++i) {
+        producers.emplace_back([&queues, i] {
+            for (int j = 0; j < 5000; ++j) {
+                if (j % 1000 == 0)
+                    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                queues[i]->push(j);
+            }
+        });
+    }
+    for (auto& t : producers)
+        t.join();
+    consumer.join();
+
+    for (int i = 0; i < 4; ++i) {
+        ASSERT_TRUE(queues[i]->empty());
+        ASSERT_EQ(sums[i], 5000LL * 4999 / 2);
+    }
+}
+
+#ifdef __linux__
+TEST(ts_interprocess_ring_queue, multiprocessrun) {
+
+    struct message {
+        int index;
+        char text[12];
+    };
+    typedef ts::interprocess::ring_queue<message> shm_queue;
+
+    std::string name = "/ts_shm_queue_test_" + std::to_string(getpid());
+    ASSERT_THROW(shm_queue::open(name), std::system_error);
+
+    auto q = shm_queue::create(name, 60);
+    // Clean up on every exit path, a failed assertion returns early. Kill
+    // children still running, they may be stuck pushing into a full queue.
+    struct cleanup {
+        const std::string& name;
+        std::vector<pid_t> children;
+        ~cleanup() {
+            for (pid_t pid : children) {
+                ::kill(pid, SIGKILL);
+                ::waitpid(pid, nullptr, 0);
+            }
+            shm_queue::unlink(name);
+        }
+    } guard{ name, {} };
+    ASSERT_EQ(q.capacity(), 64u);
+    ASSERT_THROW(shm_queue::create(name, 64), std::system_error);
+    ASSERT_THROW(ts::interprocess::ring_queue<long double>::open(name), std::system_error);
+
+    message m = { 1, "hello" };
+    ASSERT_TRUE(q.try_push(m));
+    {
+        // A second mapping of the same queue, at a different address.
+        auto other = shm_queue::open(name);
+        message out;
+        ASSERT_TRUE(other.try_pop(out));
+        ASSERT_EQ(out.index, 1);
+        ASSERT_STREQ(out.text, "hello");
+        ASSERT_FALSE(other.try_pop(out));
+    }
+    for (int i = 0; i < 64; ++i)
+        ASSERT_TRUE(q.try_push(m));
+    ASSERT_FALSE(q.try_push(m));
+    message out;
+    while (q.try_pop(out));
+    ASSERT_TRUE(q.empty());
+
+    // Two child processes produce through the small queue, so they have to
+    // sleep on the futex now and then.
+    for (int i = 0; i < 2; ++i) {
+        pid_t pid = fork();
+        ASSERT_GE(pid, 0);
+        if (pid == 0) {
+            // Never unwind into gtest, the child would run the rest of the
+            // suite as a second copy of this process.
+            int status = 0;
+            try {
+                auto child_q = shm_queue::open(name);
+                for (int j = 0; j < 10000; ++j) {
+                    message msg = { i * 10000 + j, "child" };
+                    child_q.push(msg);
+                }
+            }
+            catch (...) {
+                status = 1;
+            }
+            _exit(status);
+        }
+        guard.children.push_back(pid);
+    }
+
+    // Reap children that exited, true if one of them failed.
+    auto child_failed = [&guard] {
+        bool failed = false;
+        for (auto it = guard.children.begin(); it != guard.children.end(); ) {
+            int status;
+            if (waitpid(*it, &status, WNOHANG) != *it) {
+                ++it;
+                continue;
+            }
+            it = guard.children.erase(it);
+            failed |= !(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+        }
+        return failed;
+    };
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(60);
+
+    // Poll instead of wait_and_pop, a child that fails never sends the rest.
+    long long sum = 0;
+    int received = 0;
+    while (received < 20000) {
+        if (q.try_pop(out)) {
+            sum += out.index;
+            ++received;
+            continue;
+        }
+        ASSERT_FALSE(child_failed());
+        ASSERT_LT(std::chrono::steady_clock::now(), deadline);
+        std::this_thread::yield();
+    }
+    while (!guard.children.empty()) {
+        pid_t pid = guard.children.back();
+        guard.children.pop_back();
+        int status;
+        ASSERT_EQ(waitpid(pid, &status, 0), pid);
+        ASSERT_TRUE(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+    }
+    ASSERT_TRUE(q.empty());
+    ASSERT_EQ(sum, 20000LL * 19999 / 2);
+
+    // A child consumer blocks in wait_and_pop, the parent pushes in bursts
+    // so that it keeps running dry and sleeping on the futex.
+    pid_t consumer = fork();
+    ASSERT_GE(consumer, 0);
+    if (consumer == 0) {
+        int status = 1;
+        try {
+            auto child_q = shm_queue::open(name);
+            long long child_sum = 0;
+            message msg;
+            for (int j = 0; j < 20000; ++j) {
+                child_q.wait_and_pop(msg);
+                child_sum += msg.index;
+            }
+            status = child_sum == 20000LL * 19999 / 2 ? 0 : 1;
+        }
+        catch (...) {
+        }
+        _exit(status);
+    }
+    guard.children.push_back(consumer);
+
+    for (int i = 0; i < 20000; ++i) {
+        if (i % 1000 == 0)
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        message msg = { i, "parent" };
+        while (!q.try_push(msg)) {
+            ASSERT_FALSE(child_failed());
+            ASSERT_LT(std::chrono::steady_clock::now(), deadline);
+            std::this_thread::yield();
+        }
+    }
+    while (!guard.children.empty()) {
+        ASSERT_FALSE(child_failed());
+        ASSERT_LT(std::chrono::steady_clock::now(), deadline);
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    ASSERT_TRUE(q.empty());
+}
+#endif
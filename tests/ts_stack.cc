@@ -3,6 +3,7 @@
 #include <gtest/gtest.h>
 #include <iostream>
 #include <thread>
+#include <chrono>
 
 TEST(stack, ts) {
 
@@ -74,4 +75,229 @@ TEST(stack, lock_free) {
     // Clear the stack
     while (s.pop());
     ASSERT_TRUE(s.is_mem_operation_correct());
-}
\ No newline at end of file
+}
+
+template < class Reclaimer >
+void run_reclaimed_stack() {
+
+    ts::lock_free::stack<std::string, Reclaimer> s;
+    ASSERT_FALSE(s.pop());
+
+    std::vector<std::thread> threads;
+    for (int i = 0; i < 4; ++i) {
+        threads.emplace_back([&s, i] {
+            for (int j = 0; j < 10000; ++j)
+                s.push(std::to_string(i * 10000 + j));
+        });
+    }
+
+    std::atomic<int> popped = 0;
+    for (int i = 0; i < 4; ++i) {
+        threads.emplace_back([&s, &popped] {
+            for (int j = 0; j < 10000; ++j) {
+                if (s.pop())
+                    ++popped;
+            }
+        });
+    }
+
+    for (auto& t : threads)
+        t.join();
+
+    while (s.pop())
+        ++popped;
+    ASSERT_EQ(popped.load(), 40000);
+    ASSERT_TRUE(s.empty());
+}
+
+TEST(stack, lock_free_count_limit) {
+
+    // The external count saturates instead of wrapping: at the limit an
+    // increase waits until the pointer is replaced.
+    typedef ts::counted_ptr<int> counted;
+    int a = 0, b = 0;
+    std::atomic<counted> head(counted(&a, counted::_max_count - 1));
+    counted old = head.load();
+    ts::increase_external_count(head, old);
+    ASSERT_EQ(old.count(), counted::_max_count);
+
+    std::atomic<bool> done = false;
+    std::thread t([&head, &b, &done] {
+        counted cur = head.load();
+        ts::increase_external_count(head, cur);
+        ASSERT_EQ(cur.ptr(), &b);
+        ASSERT_EQ(cur.count(), 2u);
+        done = true;
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    ASSERT_FALSE(done.load());
+    ASSERT_EQ(head.load().count(), counted::_max_count);
+    head.store(counted(&b, 1));
+    t.join();
+    ASSERT_TRUE(done.load());
+
+    // Polling an empty stack does not pin its head at all.
+    ts::lock_free::stack<int> s;
+    for (int i = 0; i < 70000; ++i)
+        ASSERT_FALSE(s.pop());
+    s.push(1);
+    ASSERT_EQ(*s.pop(), 1);
+}
+
+TEST(stack, lock_free_hazard_pointer) {
+    run_reclaimed_stack<ts::reclaim::hazard_pointer>();
+}
+
+TEST(stack, lock_free_epoch) {
+    run_reclaimed_stack<ts::reclaim::epoch>();
+}
+
+TEST(stack, lock_free_pooled) {
+
+    ts::lock_free::pooled_stack<std::string> s;
+    ASSERT_FALSE(s.pop());
+
+    s.push("a");
+    std::string b = "b";
+    s.push(b);
+    s.emplace(3, 'c');
+    ASSERT_EQ(*s.pop(), "ccc");
+    std::string str;
+    ASSERT_TRUE(s.pop(str));
+    ASSERT_EQ(str, "b");
+    ASSERT_EQ(*s.pop(), "a");
+    ASSERT_TRUE(s.empty());
+
+    std::vector<std::thread> threads;
+    std::atomic<int> popped = 0;
+    for (int i = 0; i < 4; ++i) {
+        threads.emplace_back([&s, &popped, i] {
+            std::string item;
+            for (int j = 0; j < 10000; ++j) {
+                s.push(std::to_string(i * 10000 + j));
+                if (s.pop(item))
+                    ++popped;
+            }
+        });
+    }
+    for (auto& t : threads)
+        t.join();
+    while (s.pop())
+        ++popped;
+    ASSERT_EQ(popped.load(), 40000);
+
+    // Once warm, pushes and pops recycle nodes from the pool.
+    for (int i = 0; i < 50; ++i)
+        s.push(std::to_string(i));
+    while (s.pop(str)) { }
+    auto allocated = s.allocated_node_num();
+    for (int round = 0; round < 100; ++round) {
+        for (int i = 0; i < 50; ++i)
+            s.push(std::to_string(i));
+        while (s.pop(str)) { }
+    }
+    ASSERT_EQ(s.allocated_node_num(), allocated);
+
+    // Leave a few items for the destructor.
+    s.push("x");
+    s.push("y");
+}
+
+TEST(stack, lock_free_elimination) {
+
+    ts::lock_free::elimination_stack<std::string> s;
+    ASSERT_FALSE(s.pop());
+
+    s.push("a");
+    s.emplace(2, 'b');
+    ASSERT_EQ(*s.pop(), "bb");
+    ASSERT_EQ(*s.pop(), "a");
+    ASSERT_TRUE(s.empty());
+
+    std::vector<std::thread> threads;
+    std::atomic<long long> sum = 0;
+    std::atomic<int> popped = 0;
+    for (int i = 0; i < 8; ++i) {
+        threads.emplace_back([&s, &sum, &popped, i] {
+            std::string item;
+            for (int j = 0; j < 10000; ++j) {
+                s.push(std::to_string(i * 10000 + j));
+                if (s.pop(item)) {
+                    sum += std::stoi(item);
+                    ++popped;
+                }
+            }
+        });
+    }
+    for (auto& t : threads)
+        t.join();
+
+    std::string item;
+    while (s.pop(item)) {
+        sum += std::stoi(item);
+        ++popped;
+    }
+    ASSERT_EQ(popped.load(), 80000);
+    ASSERT_EQ(sum.load(), 80000LL * 79999 / 2);
+}
+
+TEST(stack, pop_all) {
+
+    ts::stack<int> s;
+    ts::lock_free::stack<int> lf;
+    ts::lock_free::stack<int, ts::reclaim::hazard_pointer> hp;
+    ts::lock_free::pooled_stack<int> pooled;
+    ts::lock_free::elimination_stack<int> elimination;
+
+    ASSERT_TRUE(s.pop_all().empty());
+    ASSERT_TRUE(lf.pop_all().empty());
+    for (int i = 0; i < 5; ++i) {
+        s.push(i);
+        lf.push(i);
+        hp.push(i);
+        pooled.push(i);
+        elimination.push(i);
+    }
+
+    ASSERT_EQ(s.pop_all(), std::vector<int>({ 4, 3, 2, 1, 0 }));
+    ASSERT_TRUE(s.empty());
+    ASSERT_EQ(pooled.pop_all(true), std::vector<int>({ 0, 1, 2, 3, 4 }));
+    ASSERT_TRUE(pooled.empty());
+    ASSERT_EQ(elimination.pop_all(), std::vector<int>({ 4, 3, 2, 1, 0 }));
+    ASSERT_TRUE(elimination.empty());
+
+    auto items = lf.pop_all(true);
+    ASSERT_EQ(items.size(), 5u);
+    for (int i = 0; i < 5; ++i)
+        ASSERT_EQ(*items[i], i);
+    ASSERT_FALSE(lf.pop());
+
+    items = hp.pop_all();
+    ASSERT_EQ(items.size(), 5u);
+    ASSERT_EQ(*items.front(), 4);
+    ASSERT_TRUE(hp.empty());
+
+    // Drain while other threads push and pop.
+    std::atomic<bool> done = false;
+    std::atomic<int> popped = 0;
+    std::vector<std::thread> threads;
+    for (int i = 0; i < 4; ++i) {
+        threads.emplace_back([&lf, &popped] {
+            for (int j = 0; j < 10000; ++j) {
+                lf.push(j);
+                if (lf.pop())
+                    ++popped;
+            }
+        });
+    }
+    std::thread drainer([&lf, &popped, &done] {
+        while (!done)
+            popped += lf.pop_all().size();
+    });
+    for (auto& t : threads)
+        t.join();
+    done = true;
+    drainer.join();
+    popped += lf.pop_all().size();
+    ASSERT_EQ(popped.load(), 40000);
+}
@@ -0,0 +1,95 @@
+#include "../ts_thread_pool.hpp"
+
+#include <gtest/gtest.h>
+#include <iostream>
+#include <numeric>
+#include <thread>
+
+TEST(work_stealing_deque, owner_and_thieves) {
+
+    ts::work_stealing_deque<int> q(4);
+    ASSERT_FALSE(q.pop());
+    ASSERT_FALSE(q.steal());
+
+    // Grows past the initial capacity
+    for (int i = 0; i < 10; ++i)
+        q.push(i);
+    ASSERT_EQ(q.size(), 10);
+    ASSERT_EQ(*q.pop(), 9);
+    ASSERT_EQ(*q.steal(), 0);
+    ASSERT_EQ(q.size(), 8);
+    while (q.pop()) { }
+    ASSERT_TRUE(q.empty());
+
+    const int count = 100000;
+    std::atomic<long long> sum = 0;
+    std::atomic<int> taken = 0;
+    std::vector<std::thread> thieves;
+    for (int i = 0; i < 3; ++i) {
+        thieves.emplace_back([&] {
+            while (taken < count) {
+                if (auto item = q.steal()) {
+                    sum += *item;
+                    ++taken;
+                }
+            }
+        });
+    }
+
+    for (int i = 0; i < count; ++i) {
+        q.push(i);
+        if (i % 3 == 0) {
+            if (auto item = q.pop()) {
+                sum += *item;
+                ++taken;
+            }
+        }
+    }
+    while (taken < count) {
+        if (auto item = q.pop()) {
+            sum += *item;
+            ++taken;
+        }
+    }
+
+    for (auto& t : thieves)
+        t.join();
+    ASSERT_EQ(taken.load(), count);
+    ASSERT_EQ(sum.load(), 1LL * count * (count - 1) / 2);
+}
+
+TEST(thread_pool, submit) {
+
+    ts::thread_pool pool(4);
+    ASSERT_EQ(pool.size(), 4);
+
+    auto f = pool.submit([] { return std::string("abc"); });
+    ASSERT_EQ(f.get(), "abc");
+
+    std::vector<std::future<int>> futures;
+    for (int i = 0; i < 1000; ++i)
+        futures.push_back(pool.submit([i] { return i; }));
+    int sum = 0;
+    for (auto& item : futures)
+        sum += item.get();
+    ASSERT_EQ(sum, 999 * 1000 / 2);
+
+    // Tasks spawning tasks go through the workers' own deques, waiting
+    // tasks help instead of blocking a worker.
+    auto outer = pool.submit([&pool] {
+        std::vector<std::future<int>> inner;
+        for (int i = 0; i < 100; ++i)
+            inner.push_back(pool.submit([i] { return i; }));
+        int sum = 0;
+        for (auto& item : inner) {
+            while (item.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+                pool.run_pending_task();
+            sum += item.get();
+        }
+        return sum;
+    });
+    ASSERT_EQ(outer.get(), 99 * 100 / 2);
+
+    auto error = pool.submit([]() -> int { throw std::runtime_error("task"); });
+    ASSERT_THROW(error.get(), std::runtime_error);
+}
@@ -0,0 +1,136 @@
+#pragma once
+
+#include <iostream>
+
+#if defined(__cpp_impl_coroutine) && __has_include(<coroutine>)
+
+#include <coroutine>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <utility>
+
+namespace ts {
+
+// Queue whose consumers co_await pop() instead of blocking a thread (C++20).
+// A consumer that finds the queue empty is parked as a coroutine handle in a
+// FIFO of waiters. push() hands the item straight to the oldest waiter and
+// resumes it, either inline on the pushing thread or through the executor
+// given to the constructor, so no thread ever sleeps on a condition variable.
+// Waiters still parked when the queue is destroyed are never resumed.
+template < class T >
+class async_queue {
+public:
+    typedef std::function<void(std::coroutine_handle<>)> executor;
+
+    class pop_awaiter {
+    private:
+        friend class async_queue;
+
+        async_queue& _queue;
+        std::coroutine_handle<> _handle;
+        std::optional<T> _result;
+        pop_awaiter* _next;
+
+    public:
+        explicit pop_awaiter(async_queue& q): _queue(q), _next(nullptr) { }
+
+        bool await_ready() {
+            std::lock_guard<std::mutex> l(_queue._m);
+            return _queue.take(_result);
+        }
+
+        // Returns false (resume right away) if an item arrived meanwhile.
+        bool await_suspend(std::coroutine_handle<> h) {
+            _handle = h;
+            std::lock_guard<std::mutex> l(_queue._m);
+            if (_queue.take(_result))
+                return false;
+            if (_queue._waiter_tail)
+                _queue._waiter_tail->_next = this;
+            else
+                _queue._waiter_head = this;
+            _queue._waiter_tail = this;
+            return true;
+        }
+
+        T await_resume() { return std::move(*_result); }
+    };
+
+private:
+    std::mutex _m;
+    std::deque<T> _data;
+    pop_awaiter* _waiter_head;
+    pop_awaiter* _waiter_tail;
+    executor _executor;
+
+    // _m must be held.
+    bool take(std::optional<T>& result) {
+        if (_data.empty())
+            return false;
+        result.emplace(std::move(_data.front()));
+        _data.pop_front();
+        return true;
+    }
+
+public:
+    // Without an executor waiters are resumed on the pushing thread.
+    explicit async_queue(executor e = executor())
+        : _waiter_head(nullptr), _waiter_tail(nullptr), _executor(std::move(e)) { }
+    async_queue(const async_queue&) = delete;
+    async_queue& operator=(const async_queue&) = delete;
+
+    void push(T data) {
+        pop_awaiter* waiter;
+        {
+            std::lock_guard<std::mutex> l(_m);
+            waiter = _waiter_head;
+            if (!waiter) {
+                _data.push_back(std::move(data));
+                return;
+            }
+            _waiter_head = waiter->_next;
+            if (!_waiter_head)
+                _waiter_tail = nullptr;
+            waiter->_result.emplace(std::move(data));
+        }
+        if (_executor)
+            _executor(waiter->_handle);
+        else
+            waiter->_handle.resume();
+    }
+
+    // co_await q.pop() yields the next item.
+    pop_awaiter pop() { return pop_awaiter(*this); }
+
+    bool try_pop(T& data) {
+        std::lock_guard<std::mutex> l(_m);
+        if (_data.empty())
+            return false;
+        data = std::move(_data.front());
+        _data.pop_front();
+        return true;
+    }
+
+    bool empty() {
+        std::lock_guard<std::mutex> l(_m);
+        return _data.empty();
+    }
+
+    int size() {
+        std::lock_guard<std::mutex> l(_m);
+        return _data.size();
+    }
+
+    int waiter_num() {
+        std::lock_guard<std::mutex> l(_m);
+        int count = 0;
+        for (pop_awaiter* w = _waiter_head; w; w = w->_next)
+            ++count;
+        return count;
+    }
+};
+}// ts
+
+#endif
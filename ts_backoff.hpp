@@ -0,0 +1,69 @@
+#pragma once
+
+#include <iostream>
+#include <atomic>
+#include <thread>
+#include <cstdint>
+#include <functional>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#include <immintrin.h>
+#endif
+
+namespace ts {
+
+// Hint to the CPU that the caller is spinning.
+inline void cpu_relax() {
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+    _mm_pause();
+#elif defined(__aarch64__) || defined(__arm__)
+    asm volatile("yield" ::: "memory");
+#else
+    std::this_thread::yield();
+#endif
+}
+
+// Cheap per-thread pseudo random numbers (xorshift).
+inline std::uint32_t thread_random() {
+    thread_local std::uint32_t state =
+        static_cast<std::uint32_t>(std::hash<std::thread::id>()(std::this_thread::get_id())) | 1;
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return state;
+}
+
+// One byte test-and-test-and-set lock for very short critical sections.
+// Waiters spin with cpu_relax for a while, then fall back to yielding.
+class spinlock {
+private:
+    static constexpr int _spin_limit = 64;
+    std::atomic<bool> _locked;
+
+public:
+    spinlock(): _locked(false) { }
+    spinlock(const spinlock&) = delete;
+    spinlock& operator=(const spinlock&) = delete;
+
+    void lock() {
+        int spins = 0;
+        while (_locked.exchange(true, std::memory_order_acquire)) {
+            while (_locked.load(std::memory_order_relaxed)) {
+                if (++spins < _spin_limit)
+                    cpu_relax();
+                else
+                    std::this_thread::yield();
+            }
+        }
+    }
+
+    bool try_lock() {
+        return !_locked.load(std::memory_order_relaxed) &&
+               !_locked.exchange(true, std::memory_order_acquire);
+    }
+
+    void unlock() {
+        _locked.store(false, std::memory_order_release);
+    }
+};
+}// ts
@@ -0,0 +1,221 @@
+#pragma once
+
+#include <iostream>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <type_traits>
+
+#include "ts_backoff.hpp"
+
+namespace ts {
+
+// Same interface and hand-over-hand locking as ts::list with a smaller
+// footprint. Each node is locked by a one-byte spinlock instead of a
+// std::mutex and stores up to Chunk items inline (no shared_ptr control
+// block, no per-item allocation), so a traversal touches a few contiguous
+// items per lock. compact_list<T, 1> is one item per node.
+// Items are stored by value, so find_first_if hands out a copy.
+template < class T, std::size_t Chunk = 4 >
+class compact_list {
+private:
+    static_assert(Chunk > 0 && Chunk <= 255, "compact_list chunk size must be in [1, 255]");
+
+    struct node;
+
+    struct link {
+        mutable spinlock _m;
+        std::uint8_t _count;
+        node* _next;
+        link(): _count(0), _next(nullptr) { }
+    };
+
+    struct node: link {
+        typename std::aligned_storage<sizeof(T), alignof(T)>::type _items[Chunk];
+
+        ~node() {
+            for (std::size_t i = 0; i < this->_count; ++i)
+                item(i).~T();
+        }
+
+        T& item(std::size_t i) { return *std::launder(reinterpret_cast<T*>(&_items[i])); }
+        const T& item(std::size_t i) const {
+            return *std::launder(reinterpret_cast<const T*>(&_items[i]));
+        }
+
+        void add(const T& data) {
+            new (&_items[this->_count]) T(data);
+            ++this->_count;
+        }
+
+        // Fill the hole with the last item, order inside a chunk is not kept.
+        void remove(std::size_t i) {
+            std::size_t last = this->_count - 1;
+            if (i != last)
+                item(i) = std::move(item(last));
+            item(last).~T();
+            --this->_count;
+        }
+    };
+
+    typedef std::unique_lock<spinlock> lock_type;
+
+    void delete_all() {
+        node* cur = _head._next;
+        _head._next = nullptr;
+        while (cur) {
+            node* next = cur->_next;
+            delete cur;
+            cur = next;
+        }
+    }
+
+public:
+    compact_list(): _head() { }
+    ~compact_list() { delete_all(); }
+    compact_list(const compact_list&) = delete;
+    compact_list& operator=(const compact_list&) = delete;
+    // Neither list may be in use by other threads while moving.
+    compact_list(compact_list&& other) {
+        _head._next = other._head._next;
+        other._head._next = nullptr;
+    }
+    compact_list& operator=(compact_list&& other) {
+        delete_all();
+        _head._next = other._head._next;
+        other._head._next = nullptr;
+        return *this;
+    }
+
+    // Add data in front, into the first chunk if it has room.
+    void push_back(const T& data) {
+        lock_type l(_head._m);
+        node* first = _head._next;
+        if (first) {
+            lock_type fl(first->_m);
+            if (first->_count < Chunk) {
+                first->add(data);
+                return;
+            }
+        }
+        auto item = std::make_unique<node>();
+        item->add(data);
+        item->_next = first;
+        _head._next = item.release();
+    }
+
+    template < typename Predicate >
+    std::shared_ptr<T> find_first_if(Predicate p) const {
+        const link* cur = &_head;
+        lock_type l(_head._m);
+        while (const node* next = cur->_next) {
+            lock_type nl(next->_m);
+            l.unlock();
+
+            for (std::size_t i = 0; i < next->_count; ++i) {
+                if (p(next->item(i)))
+                    return std::make_shared<T>(next->item(i));
+            }
+
+            cur = next;
+            l = std::move(nl);
+        }
+        return std::shared_ptr<T>();
+    }
+
+    // Replace the first item matching p with data, or append data at the end.
+    // The last node stays locked from the failed scan to the append, so two
+    // inserts of the same item cannot both append it.
+    template < typename Predicate >
+    void insert(Predicate p, const T& data) {
+        link* cur = &_head;
+        lock_type l(_head._m);
+        while (node* next = cur->_next) {
+            lock_type nl(next->_m);
+            l.unlock();
+
+            for (std::size_t i = 0; i < next->_count; ++i) {
+                if (p(next->item(i))) {
+                    next->item(i) = data;
+                    return;
+                }
+            }
+
+            cur = next;
+            l = std::move(nl);
+        }
+
+        if (cur != &_head && cur->_count < Chunk) {
+            static_cast<node*>(cur)->add(data);
+            return;
+        }
+        auto item = std::make_unique<node>();
+        item->add(data);
+        cur->_next = item.release();
+    }
+
+    template < typename Predicate >
+    void remove_if(Predicate p) {
+        link* cur = &_head;
+        lock_type l(_head._m);
+        while (node* next = cur->_next) {
+            lock_type nl(next->_m);
+            for (std::size_t i = 0; i < next->_count; ) {
+                if (p(next->item(i)))
+                    next->remove(i);
+                else
+                    ++i;
+            }
+
+            if (!next->_count) {
+                cur->_next = next->_next;
+                nl.unlock();
+                delete next;
+            }
+            else {
+                l.unlock();
+                cur = next;
+                l = std::move(nl);
+            }
+        }
+    }
+
+    int size() const {
+        int size = 0;
+        const link* cur = &_head;
+        lock_type l(_head._m);
+        while (const node* next = cur->_next) {
+            lock_type nl(next->_m);
+            l.unlock();
+            size += next->_count;
+            cur = next;
+            l = std::move(nl);
+        }
+        return size;
+    }
+
+    void clear() {
+        remove_if([](const T&) { return true; });
+    }
+
+    std::list<T> get_list() const {
+        std::list<T> list;
+        const link* cur = &_head;
+        lock_type l(_head._m);
+        while (const node* next = cur->_next) {
+            lock_type nl(next->_m);
+            l.unlock();
+            for (std::size_t i = 0; i < next->_count; ++i)
+                list.push_back(next->item(i));
+            cur = next;
+            l = std::move(nl);
+        }
+        return list;
+    }
+
+private:
+    link _head;
+};
+}// ts
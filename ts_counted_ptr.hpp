@@ -0,0 +1,89 @@
+#pragma once
+
+#include <iostream>
+#include <atomic>
+#include <cstdint>
+#include <thread>
+
+namespace ts {
+
+// Pointer plus external reference count, the value the split reference
+// counting containers CAS as a whole.
+//
+// By default both are packed into one 64-bit word: the count lives in the
+// upper 16 bits, which are unused by user-space pointers on x86-64 (4-level
+// paging) and AArch64 (48-bit VA, no top-byte tagging). std::atomic of it is
+// then always lock-free and the containers static_assert that.
+//
+// Define TS_WIDE_COUNTED_PTR for targets where pointers may use the upper
+// bits (e.g. x86-64 with 5-level paging). The count and pointer are then kept
+// in a 16-byte struct, which is only lock-free where the compiler emits a
+// double-width CAS (x86-64 needs -mcx16, and GCC still routes it through
+// libatomic); otherwise the "lock_free" containers silently take libatomic's
+// internal locks, so the static_assert is dropped in that mode.
+template < class Node >
+class counted_ptr {
+#ifndef TS_WIDE_COUNTED_PTR
+private:
+    static constexpr int _pointer_bits = 48;
+    static constexpr std::uint64_t _pointer_mask = (std::uint64_t(1) << _pointer_bits) - 1;
+
+    std::uint64_t _value;
+
+public:
+    static constexpr unsigned _max_count = 0xffff;
+
+    counted_ptr(): _value(0) { }
+    counted_ptr(Node* ptr, unsigned count)
+        : _value((std::uint64_t(count) << _pointer_bits) |
+                 (reinterpret_cast<std::uintptr_t>(ptr) & _pointer_mask)) { }
+
+    Node* ptr() const {
+        return reinterpret_cast<Node*>(static_cast<std::uintptr_t>(_value & _pointer_mask));
+    }
+    unsigned count() const {
+        return static_cast<unsigned>(_value >> _pointer_bits);
+    }
+#else
+private:
+    // Pointer sized so the struct has no padding bytes, which
+    // compare_exchange would otherwise compare too.
+    std::uintptr_t _count;
+    Node* _ptr;
+
+public:
+    static constexpr unsigned _max_count = 0xffffffff;
+
+    counted_ptr(): _count(0), _ptr(nullptr) { }
+    counted_ptr(Node* ptr, unsigned count): _count(count), _ptr(ptr) { }
+
+    Node* ptr() const { return _ptr; }
+    unsigned count() const { return static_cast<unsigned>(_count); }
+#endif
+
+    counted_ptr with_count(unsigned count) const {
+        return counted_ptr(ptr(), count);
+    }
+};
+
+// Bump the external count of the node src points to, old ends up holding the
+// new value. The count only starts over once another pointer replaces the
+// one in src, so at _max_count this waits for that instead of wrapping.
+template < class Node >
+void increase_external_count(std::atomic<counted_ptr<Node>>& src, counted_ptr<Node>& old,
+                             std::memory_order success = std::memory_order_seq_cst,
+                             std::memory_order failure = std::memory_order_seq_cst) {
+    counted_ptr<Node> new_ptr;
+    while (true) {
+        if (old.count() == counted_ptr<Node>::_max_count) {
+            std::this_thread::yield();
+            old = src.load(failure);
+            continue;
+        }
+        new_ptr = old.with_count(old.count() + 1);
+        if (src.compare_exchange_strong(old, new_ptr, success, failure))
+            break;
+    }
+    old = new_ptr;
+}
+}// ts
@@ -0,0 +1,109 @@
+#pragma once
+
+#include <iostream>
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <system_error>
+
+#ifdef __linux__
+#include <sys/eventfd.h>
+#include <unistd.h>
+#endif
+
+#include "ts_wait_policy.hpp"
+
+namespace ts {
+
+#ifdef __linux__
+// Non-blocking eventfd that can sit in an epoll/poll set next to sockets.
+class eventfd_notifier {
+private:
+    int _fd;
+
+public:
+    eventfd_notifier(): _fd(::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)) {
+        if (_fd < 0)
+            throw std::system_error(errno, std::generic_category(), "eventfd");
+    }
+    ~eventfd_notifier() { ::close(_fd); }
+    eventfd_notifier(const eventfd_notifier&) = delete;
+    eventfd_notifier& operator=(const eventfd_notifier&) = delete;
+
+    int fd() const { return _fd; }
+
+    // Make fd() readable.
+    void notify() {
+        std::uint64_t one = 1;
+        while (::write(_fd, &one, sizeof(one)) < 0 && errno == EINTR);
+    }
+
+    // Make fd() non-readable again.
+    void clear() {
+        std::uint64_t count;
+        while (::read(_fd, &count, sizeof(count)) < 0 && errno == EINTR);
+    }
+};
+#endif
+
+namespace wait {
+
+// Waiting policy that also drives a readiness notifier, for consumers that
+// sit in an event loop instead of blocking in wait_and_pop. Blocking waits
+// still go through Base.
+// Notifier needs notify() and clear(). It is signaled when an item arrives
+// and stays signaled, without further notify() calls, until the consumer
+// calls ack(). The event loop therefore has to ack() first and then drain the
+// queue with try_pop until it is empty:
+//
+//     ts::fine_tuned::queue<T, ts::wait::readiness<ts::eventfd_notifier>> q;
+//     epoll_ctl(ep, EPOLL_CTL_ADD, q.wait_policy().notifier().fd(), &ev);
+//     ...
+//     q.wait_policy().ack();
+//     while (q.try_pop(item)) ...
+template < class Notifier, class Base = blocking >
+class readiness {
+private:
+    Base _base;
+    Notifier _notifier;
+    std::atomic<bool> _signaled;
+
+    void signal() {
+        if (_signaled.load(std::memory_order_relaxed))
+            return;
+        if (!_signaled.exchange(true, std::memory_order_seq_cst))
+            _notifier.notify();
+    }
+
+public:
+    readiness(): _signaled(false) { }
+
+    template < class Lock, class Predicate >
+    void wait(Lock& l, Predicate p) {
+        _base.wait(l, p);
+    }
+
+    void notify_one() {
+        signal();
+        _base.notify_one();
+    }
+
+    void notify_all() {
+        signal();
+        _base.notify_all();
+    }
+
+    // Re-arm the notifier. Items pushed before ack() returned may not signal
+    // again, so drain the queue afterwards.
+    void ack() {
+        _notifier.clear();
+        _signaled.store(false, std::memory_order_seq_cst);
+    }
+
+    Notifier& notifier() { return _notifier; }
+};
+
+template < class Notifier, class Base >
+struct notifies_unlocked<readiness<Notifier, Base>> : notifies_unlocked<Base> { };
+}// wait
+}// ts
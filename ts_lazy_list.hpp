@@ -0,0 +1,179 @@
+#pragma once
+
+#include <iostream>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <list>
+
+#include "ts_reclaim.hpp"
+
+namespace ts {
+
+// Drop-in alternative to ts::list with lazy synchronization.
+// Readers (find_first_if, size, get_list) walk the list without taking any
+// lock and skip nodes whose _marked flag is set. Writers lock only the
+// predecessor and the node they change, then validate that neither is marked
+// and that they are still linked before touching them. A node's data never
+// changes: insert on a matching node links a replacement node in its place.
+// Unlinked nodes are reclaimed through epochs, so readers never see them
+// freed.
+template < class T >
+class lazy_list {
+private:
+    struct node {
+        std::mutex _m;
+        std::atomic<bool> _marked;
+        const std::shared_ptr<T> _data;
+        std::atomic<node*> _next;
+        node(): _marked(false), _data(), _next(nullptr) { }
+        explicit node(const T& data)
+            : _marked(false), _data(std::make_shared<T>(data)), _next(nullptr) { }
+    };
+
+    // pred and cur must be locked.
+    static bool validate(node* pred, node* cur) {
+        return !pred->_marked.load(std::memory_order_relaxed) &&
+               !cur->_marked.load(std::memory_order_relaxed) &&
+               pred->_next.load(std::memory_order_relaxed) == cur;
+    }
+
+    void delete_all() {
+        node* cur = _head._next.exchange(nullptr);
+        while (cur) {
+            node* next = cur->_next.load(std::memory_order_relaxed);
+            delete cur;
+            cur = next;
+        }
+    }
+
+public:
+    lazy_list(): _head() { }
+    // Make sure no thread now is accessing current list instance
+    ~lazy_list() { delete_all(); }
+    lazy_list(const lazy_list&) = delete;
+    lazy_list& operator=(const lazy_list&) = delete;
+    // Neither list may be in use by other threads while moving.
+    lazy_list(lazy_list&& other) {
+        _head._next.store(other._head._next.exchange(nullptr));
+    }
+    lazy_list& operator=(lazy_list&& other) {
+        delete_all();
+        _head._next.store(other._head._next.exchange(nullptr));
+        return *this;
+    }
+
+    void push_back(const T& data) {
+        node* item = new node(data);
+        std::lock_guard<std::mutex> l(_head._m);
+        item->_next.store(_head._next.load(std::memory_order_relaxed), std::memory_order_relaxed);
+        _head._next.store(item, std::memory_order_release);
+    }
+
+    template < typename Predicate >
+    std::shared_ptr<T> find_first_if(Predicate p) const {
+        reclaim::epoch::guard guard;
+        for (node* cur = _head._next.load(std::memory_order_acquire); cur;
+             cur = cur->_next.load(std::memory_order_acquire)) {
+            if (!cur->_marked.load(std::memory_order_acquire) && p(*cur->_data))
+                return cur->_data;
+        }
+        return std::shared_ptr<T>();
+    }
+
+    // Replace the first item matching p with data, or add data if none does.
+    template < typename Predicate >
+    void insert(Predicate p, const T& data) {
+        reclaim::epoch::guard guard;
+        while (true) {
+            node* first = _head._next.load(std::memory_order_acquire);
+            node* pred = &_head;
+            node* cur = first;
+            // A marked match may just have been replaced, so do not skip it,
+            // the validation below sends us around again.
+            while (cur && !p(*cur->_data)) {
+                pred = cur;
+                cur = cur->_next.load(std::memory_order_acquire);
+            }
+
+            if (!cur) {
+                // Nothing matched, add in front unless some other insert got
+                // there first (it may have added a match).
+                std::lock_guard<std::mutex> l(_head._m);
+                if (_head._next.load(std::memory_order_relaxed) != first)
+                    continue;
+                node* item = new node(data);
+                item->_next.store(first, std::memory_order_relaxed);
+                _head._next.store(item, std::memory_order_release);
+                return;
+            }
+
+            std::scoped_lock l(pred->_m, cur->_m);
+            if (!validate(pred, cur))
+                continue;
+            // Link the replacement behind cur first, so a reader that finds
+            // cur marked still runs into it.
+            node* item = new node(data);
+            item->_next.store(cur->_next.load(std::memory_order_relaxed), std::memory_order_relaxed);
+            cur->_next.store(item, std::memory_order_release);
+            cur->_marked.store(true, std::memory_order_release);
+            pred->_next.store(item, std::memory_order_release);
+            reclaim::epoch::retire(cur);
+            return;
+        }
+    }
+
+    template < typename Predicate >
+    void remove_if(Predicate p) {
+        reclaim::epoch::guard guard;
+        node* pred = &_head;
+        while (node* cur = pred->_next.load(std::memory_order_acquire)) {
+            if (!p(*cur->_data)) {
+                pred = cur;
+                continue;
+            }
+
+            std::unique_lock<std::mutex> pl(pred->_m);
+            std::unique_lock<std::mutex> cl(cur->_m);
+            if (!validate(pred, cur)) {
+                // Lost a race with another writer, start over.
+                pred = &_head;
+                continue;
+            }
+            cur->_marked.store(true, std::memory_order_release);
+            pred->_next.store(cur->_next.load(std::memory_order_relaxed), std::memory_order_release);
+            cl.unlock();
+            reclaim::epoch::retire(cur);
+        }
+    }
+
+    int size() const {
+        reclaim::epoch::guard guard;
+        int size = 0;
+        for (node* cur = _head._next.load(std::memory_order_acquire); cur;
+             cur = cur->_next.load(std::memory_order_acquire)) {
+            if (!cur->_marked.load(std::memory_order_acquire))
+                ++size;
+        }
+        return size;
+    }
+
+    void clear() {
+        remove_if([](const T&) { return true; });
+    }
+
+    std::list<T> get_list() const {
+        reclaim::epoch::guard guard;
+        std::list<T> list;
+        for (node* cur = _head._next.load(std::memory_order_acquire); cur;
+             cur = cur->_next.load(std::memory_order_acquire)) {
+            if (!cur->_marked.load(std::memory_order_acquire))
+                list.push_back(*cur->_data);
+        }
+        return list;
+    }
+
+private:
+    node _head;
+};
+}// ts
@@ -1,11 +1,24 @@
+#pragma once
+
 #include <iostream>
+#include <atomic>
 #include <functional>
 #include <memory>
 #include <shared_mutex>
 #include <map>
+#include <list>
+#include <vector>
+#include <algorithm>
+
+#include "ts_reclaim.hpp"
+#include "ts_table_chain.hpp"
 
 namespace ts {
 
+// The bucket array grows online through a table_chain, see
+// ts_table_chain.hpp. A bucket moves under its own exclusive lock. A lookup
+// starts in the old table and follows a bucket that has moved to the new
+// one, so nothing ever waits for the whole map.
 template < class Key, class Value, class Hash = std::hash<Key>>
 class map {
 private:
@@ -15,18 +28,20 @@ private:
         typedef typename std::list<bucket_value>::const_iterator const_bucket_iterator;
         typedef typename std::list<bucket_value>::iterator bucket_iterator;
         mutable std::shared_mutex _m;
+        // Items went to the next table, protected by _m.
+        bool _moved;
         friend class map;
 
     public:
-        bucket(): _list() {}
-        bucket(const bucket& other) {
+        bucket(): _list(), _moved(false) {}
+        bucket(const bucket& other): _moved(false) {
             this->_list = other._list;
         }
         bucket& operator=(const bucket& other) {
             this->_list = other._list;
             return *this;
         }
-        bucket(bucket&& other) {
+        bucket(bucket&& other): _moved(false) {
             this->_list = std::move(other._list);
         }
         bucket& operator=(bucket&& other) {
@@ -46,111 +61,172 @@ private:
                 });
         }
 
+        // The following expect _m to be held.
         bool find(const Key& key) const {
-            std::shared_lock l(_m);
             auto it = find_cons_iterator(key);
             return it != _list.cend();
         }
 
         Value get(const Key& key) const {
-            std::shared_lock l(_m);
             auto it = find_cons_iterator(key);
             return it == _list.cend() ? Value() : it->second;
         }
 
-        void insert(const Key& key, const Value& value) {
-            std::unique_lock l(_m);
+        // Returns the change in item count.
+        int insert(const Key& key, const Value& value) {
             auto it = find_iterator(key);
-            if (it == _list.cend())
+            if (it == _list.cend()) {
                 _list.push_back(bucket_value(key, value));
-            else
-                it->second = value;
+                return 1;
+            }
+            it->second = value;
+            return 0;
         }
 
-        void erase(const Key& key) {
-            std::unique_lock l(_m);
+        int erase(const Key& key) {
             auto it = find_cons_iterator(key);
-            if (it != _list.cend())
-                _list.erase(it);
+            if (it == _list.cend())
+                return 0;
+            _list.erase(it);
+            return -1;
         }
     };
 
-private:
+    typedef typename table_chain<bucket>::table table;
+
     static const int _default_bucket_size = 19;
-    const int _bucket_size;
     const Hash _hash;
-    std::vector<bucket> _buckets;
+    table_chain<bucket> _tables;
+    std::atomic<int> _size;
+
+    // b belongs to from and is locked exclusively.
+    void move_bucket(table* from, bucket& b, table* to) {
+        while (!b._list.empty()) {
+            bucket& target = to->get_bucket(_hash(b._list.front().first));
+            std::unique_lock l(target._m);
+            target._list.splice(target._list.end(), b._list, b._list.begin());
+        }
+        b._moved = true;
+        _tables.bucket_moved(from);
+    }
+
+    // Run f on the bucket currently holding key, under a shared lock.
+    template < class Func >
+    auto read(const Key& key, Func f) const {
+        reclaim::epoch::guard guard;
+        std::size_t hash = _hash(key);
+        for (table* t = _tables.first(); ; t = t->_next.load(std::memory_order_acquire)) {
+            const bucket& b = t->get_bucket(hash);
+            std::shared_lock l(b._m);
+            if (!b._moved)
+                return f(b);
+        }
+    }
+
+    // Run f on the bucket of key in the newest table, under an exclusive
+    // lock. Older buckets of key are moved on the way.
+    template < class Func >
+    void write(const Key& key, Func f) {
+        reclaim::epoch::guard guard;
+        std::size_t hash = _hash(key);
+        table* t = _tables.first();
+        _tables.help_migrate(t, [this](table* from, bucket& b, table* to) {
+            std::unique_lock l(b._m);
+            if (!b._moved)
+                move_bucket(from, b, to);
+        });
+        while (true) {
+            bucket& b = t->get_bucket(hash);
+            std::unique_lock l(b._m);
+            if (!b._moved) {
+                table* next = t->_next.load(std::memory_order_acquire);
+                if (!next) {
+                    _size.fetch_add(f(b), std::memory_order_relaxed);
+                    break;
+                }
+                move_bucket(t, b, next);
+            }
+            l.unlock();
+            t = t->_next.load(std::memory_order_acquire);
+        }
+        _tables.grow_if_needed(_size.load(std::memory_order_relaxed));
+    }
+
+    // Lock every bucket of every table, oldest first, and run f on those
+    // still holding items.
+    template < class Func >
+    void for_all_buckets(Func f) const {
+        reclaim::epoch::guard guard;
+        std::vector<table*> tables;
+        std::vector<std::unique_lock<std::shared_mutex>> lock_vector;
+        // Items only reach a newer table after their bucket moved, which
+        // needs the locks we hold, so the chain cannot outgrow us.
+        for (table* t = _tables.first(); t; t = t->_next.load(std::memory_order_acquire)) {
+            tables.push_back(t);
+            for (auto it = t->_buckets.cbegin(); it != t->_buckets.cend(); ++it)
+                lock_vector.push_back(std::unique_lock(it->_m));
+        }
+        for (table* t : tables) {
+            for (auto it = t->_buckets.begin(); it != t->_buckets.end(); ++it) {
+                if (!it->_moved)
+                    f(*it);
+            }
+        }
+    }
 
 public:
     map(
-        int bucket_size = _default_bucket_size, 
+        int bucket_size = _default_bucket_size,
         const Hash& hash = Hash())
-        : _bucket_size(bucket_size),
-          _hash(hash),
-          _buckets(_bucket_size) { }
+        : _hash(hash),
+          _tables(std::max(bucket_size, 1)),
+          _size(0) { }
     map(const map&) = delete;
     map& operator=(const map&) = delete;
 
-    bucket& get_bucket(const Key& key) {
-        return _buckets[_hash(key)%_bucket_size];
-    }
-    const bucket& get_cons_bucket(const Key& key) const {
-        return _buckets[_hash(key)%_bucket_size];
-    }
-
     bool find(const Key& key) const {
-        return get_cons_bucket(key).find(key);
+        return read(key, [&](const bucket& b) { return b.find(key); });
     }
 
     Value get(const Key& key) const {
-        return get_cons_bucket(key).get(key);
+        return read(key, [&](const bucket& b) { return b.get(key); });
     }
 
     void insert(const Key& key, const Value& value) {
-        get_bucket(key).insert(key, value);
+        write(key, [&](bucket& b) { return b.insert(key, value); });
     }
 
     void erase(const Key& key) {
-        get_bucket(key).erase(key);
-    }
-
-    std::vector<std::unique_lock<std::shared_mutex>> lock_all_buckets() const {
-
-        std::vector<std::unique_lock<std::shared_mutex>> lock_vector;
-        for (auto it = _buckets.cbegin(); it != _buckets.cend(); ++it) {
-            lock_vector.push_back(std::unique_lock(it->_m));
-        }
-
-        return lock_vector;
+        write(key, [&](bucket& b) { return b.erase(key); });
     }
 
     int size() const {
-        int size = 0;
-        auto lock_vector = lock_all_buckets();
-        for (auto it = _buckets.cbegin(); it != _buckets.cend(); ++it)
-            size += it->_list.size();
-        return size;
+        return _size.load(std::memory_order_relaxed);
     }
 
     bool empty() const {
         return size() == 0;
     }
-    
+
+    int bucket_count() const {
+        reclaim::epoch::guard guard;
+        return static_cast<int>(_tables.newest()->_buckets.size());
+    }
+
     void clear() {
-        auto lock_vector = lock_all_buckets();
-        for (auto it = _buckets.begin(); it != _buckets.end(); ++it)
-            it->_list.clear();
+        for_all_buckets([this](bucket& b) {
+            _size.fetch_sub(static_cast<int>(b._list.size()), std::memory_order_relaxed);
+            b._list.clear();
+        });
     }
 
     std::map<Key, Value> get_map() {
         std::map<Key, Value> map;
-        auto lock_vector = lock_all_buckets();
-        for (auto it = _buckets.cbegin(); it != _buckets.cend(); ++it) {
-            auto& list = it->_list;
-            for (auto& ele : list)
+        for_all_buckets([&map](bucket& b) {
+            for (auto& ele : b._list)
                 map.insert(ele);
-        }
+        });
         return map;
     }
 };
-}
\ No newline at end of file
+}
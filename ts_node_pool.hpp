@@ -0,0 +1,166 @@
+#pragma once
+
+#include <iostream>
+#include <atomic>
+#include <mutex>
+#include <type_traits>
+
+namespace ts {
+
+// Free-list allocator for fixed-size nodes.
+// Every thread keeps a small cache of free blocks and exchanges them in batches
+// with a shared overflow list, so under sustained load allocate/deallocate stay
+// off the global allocator. Blocks are only handed back to the system at
+// program exit, which also keeps node memory type-stable while it runs.
+// deallocate() may also run from deferred reclamation at thread or program
+// exit, after the pool's own thread cache or shared list is gone; blocks then
+// bypass the dead parts.
+template < class Node >
+class node_pool {
+private:
+    union block {
+        block* next;
+        typename std::aligned_storage<sizeof(Node), alignof(Node)>::type storage;
+    };
+
+    static constexpr std::size_t _batch_size = 64;
+
+    struct shared_list {
+        std::mutex _m;
+        block* _head = nullptr;
+        ~shared_list() {
+            _shared_destroyed = true;
+            while (_head) {
+                block* next = _head->next;
+                delete _head;
+                _head = next;
+            }
+        }
+    };
+
+    struct thread_cache {
+        block* _head = nullptr;
+        std::size_t _count = 0;
+        // Construct the shared list first so that it outlives every cache.
+        thread_cache() { shared(); cache_state() = cache_alive; }
+        ~thread_cache() {
+            cache_state() = cache_destroyed;
+            if (_head)
+                give_back(*this, _count);
+        }
+    };
+
+    enum { cache_none, cache_alive, cache_destroyed };
+
+    static std::atomic<std::size_t> _allocated_num;
+    // Trivially destructible, so they can be read at any point during exit.
+    static bool _shared_destroyed;
+    static int& cache_state() {
+        thread_local int state = cache_none;
+        return state;
+    }
+
+    static shared_list& shared() {
+        static shared_list list;
+        return list;
+    }
+
+    // Whether cache() may be used. A thread without a cache must not build
+    // one once the shared list is gone: that only happens during static
+    // destruction, e.g. for nodes retired into a static reclamation domain.
+    static bool cache_usable() {
+        int state = cache_state();
+        return state == cache_alive || (state == cache_none && !_shared_destroyed);
+    }
+
+    static thread_cache& cache() {
+        thread_local thread_cache c;
+        return c;
+    }
+
+    // Move a batch from the shared list into the thread cache.
+    static void refill(thread_cache& c) {
+        auto& s = shared();
+        std::lock_guard<std::mutex> l(s._m);
+        while (s._head && c._count < _batch_size) {
+            block* b = s._head;
+            s._head = b->next;
+            b->next = c._head;
+            c._head = b;
+            ++c._count;
+        }
+    }
+
+    // Free one block without going through the thread cache.
+    static void release(block* b) {
+        if (_shared_destroyed) {
+            delete b;
+            return;
+        }
+        auto& s = shared();
+        std::lock_guard<std::mutex> l(s._m);
+        b->next = s._head;
+        s._head = b;
+    }
+
+    // Move count blocks from the thread cache to the shared list.
+    static void give_back(thread_cache& c, std::size_t count) {
+        block* first = c._head;
+        block* last = first;
+        for (std::size_t i = 1; i < count; ++i)
+            last = last->next;
+        c._head = last->next;
+        c._count -= count;
+
+        auto& s = shared();
+        std::lock_guard<std::mutex> l(s._m);
+        last->next = s._head;
+        s._head = first;
+    }
+
+public:
+    // Returns uninitialized storage for one Node.
+    static void* allocate() {
+        if (!cache_usable()) {
+            ++_allocated_num;
+            return &(new block)->storage;
+        }
+        auto& c = cache();
+        if (!c._head)
+            refill(c);
+        if (!c._head) {
+            ++_allocated_num;
+            return &(new block)->storage;
+        }
+        block* b = c._head;
+        c._head = b->next;
+        --c._count;
+        return &b->storage;
+    }
+
+    // ptr must come from allocate() and the Node in it must be destroyed.
+    static void deallocate(void* ptr) {
+        block* b = reinterpret_cast<block*>(ptr);
+        if (!cache_usable()) {
+            release(b);
+            return;
+        }
+        auto& c = cache();
+        b->next = c._head;
+        c._head = b;
+        if (++c._count >= 2 * _batch_size)
+            give_back(c, _batch_size);
+    }
+
+    // Number of blocks ever requested from the global allocator.
+    static std::size_t allocated_num() {
+        return _allocated_num.load();
+    }
+};
+
+template < class Node >
+std::atomic<std::size_t> node_pool<Node>::_allocated_num = 0;
+
+template < class Node >
+bool node_pool<Node>::_shared_destroyed = false;
+}// ts
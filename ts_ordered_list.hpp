@@ -0,0 +1,219 @@
+#pragma once
+
+#include <iostream>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <memory>
+#include <utility>
+
+#include "ts_reclaim.hpp"
+
+namespace ts {
+namespace lock_free {
+
+// Harris-Michael sorted linked list of unique keys.
+// Erasing a node first marks the low bit of its next pointer (logical
+// deletion) so no insert can link behind it, then unlinks it; any traversal
+// that runs into a marked node helps unlinking it. Values live behind an
+// atomic pointer, an insert on an existing key swaps in a new value. Unlinked
+// nodes and replaced values are reclaimed through epochs.
+// contains() and get() never write to the list and never retry, so they are
+// wait-free as long as the list does not grow under them forever.
+template < class Key, class Value, class Compare = std::less<Key> >
+class ordered_list {
+private:
+    struct node {
+        const Key _key;
+        std::atomic<Value*> _value;
+        std::atomic<node*> _next;
+        node(const Key& key, Value* value): _key(key), _value(value), _next(nullptr) { }
+        ~node() { delete _value.load(std::memory_order_relaxed); }
+    };
+
+    static bool is_marked(node* p) {
+        return reinterpret_cast<std::uintptr_t>(p) & 1;
+    }
+    static node* marked(node* p) {
+        return reinterpret_cast<node*>(reinterpret_cast<std::uintptr_t>(p) | 1);
+    }
+    static node* unmarked(node* p) {
+        return reinterpret_cast<node*>(reinterpret_cast<std::uintptr_t>(p) & ~std::uintptr_t(1));
+    }
+
+    std::atomic<node*> _head;
+    Compare _compare;
+
+    bool equal(const Key& a, const Key& b) const {
+        return !_compare(a, b) && !_compare(b, a);
+    }
+
+    // Position prev/cur around key, unlinking marked nodes on the way.
+    // cur is the first node not less than key; returns whether it equals key.
+    // Must run inside an epoch guard.
+    bool search(const Key& key, std::atomic<node*>*& prev, node*& cur) {
+    retry:
+        prev = &_head;
+        cur = prev->load(std::memory_order_acquire);
+        while (cur) {
+            node* next = cur->_next.load(std::memory_order_acquire);
+            if (is_marked(next)) {
+                node* succ = unmarked(next);
+                node* expected = cur;
+                // Fails if prev itself got marked or changed, start over.
+                if (!prev->compare_exchange_strong(expected, succ, std::memory_order_acq_rel,
+                                                   std::memory_order_acquire))
+                    goto retry;
+                reclaim::epoch::retire(cur);
+                cur = succ;
+                continue;
+            }
+            if (!_compare(cur->_key, key))
+                return !_compare(key, cur->_key);
+            prev = &cur->_next;
+            cur = next;
+        }
+        return false;
+    }
+
+    // Read-only lookup, skips marked nodes instead of unlinking them.
+    // Must run inside an epoch guard.
+    node* lookup(const Key& key) const {
+        node* cur = _head.load(std::memory_order_acquire);
+        while (cur && _compare(cur->_key, key))
+            cur = unmarked(cur->_next.load(std::memory_order_acquire));
+        if (!cur || !equal(cur->_key, key) || is_marked(cur->_next.load(std::memory_order_acquire)))
+            return nullptr;
+        return cur;
+    }
+
+public:
+    explicit ordered_list(const Compare& compare = Compare())
+        : _head(nullptr), _compare(compare) { }
+    // Make sure no thread now is accessing current list instance
+    ~ordered_list() {
+        node* cur = _head.load();
+        while (cur) {
+            node* next = unmarked(cur->_next.load());
+            delete cur;
+            cur = next;
+        }
+    }
+    ordered_list(const ordered_list&) = delete;
+    ordered_list& operator=(const ordered_list&) = delete;
+
+    // Returns false if key was present, its value is replaced then.
+    bool insert(const Key& key, const Value& value) {
+        // Owned here until a node or the existing entry takes it over.
+        std::unique_ptr<Value> new_value(new Value(value));
+        node* new_node = nullptr;
+        reclaim::epoch::guard guard;
+        std::atomic<node*>* prev;
+        node* cur;
+
+        while (true) {
+            if (search(key, prev, cur)) {
+                if (new_node) {
+                    new_value.reset(new_node->_value.exchange(nullptr, std::memory_order_relaxed));
+                    delete new_node;
+                }
+                Value* old = cur->_value.exchange(new_value.release(), std::memory_order_acq_rel);
+                reclaim::epoch::retire(old);
+                return false;
+            }
+            if (!new_node) {
+                new_node = new node(key, new_value.get());
+                new_value.release();
+            }
+            new_node->_next.store(cur, std::memory_order_relaxed);
+            if (prev->compare_exchange_strong(cur, new_node, std::memory_order_release,
+                                              std::memory_order_relaxed))
+                return true;
+        }
+    }
+
+    // Returns false if key was not present.
+    bool erase(const Key& key) {
+        reclaim::epoch::guard guard;
+        std::atomic<node*>* prev;
+        node* cur;
+
+        while (true) {
+            if (!search(key, prev, cur))
+                return false;
+            node* next = cur->_next.load(std::memory_order_acquire);
+            if (is_marked(next))
+                continue;
+            if (!cur->_next.compare_exchange_strong(next, marked(next), std::memory_order_acq_rel,
+                                                    std::memory_order_relaxed))
+                continue;
+            // Logically gone, unlink now or leave it to the next search.
+            node* expected = cur;
+            if (prev->compare_exchange_strong(expected, next, std::memory_order_acq_rel,
+                                              std::memory_order_relaxed))
+                reclaim::epoch::retire(cur);
+            else
+                search(key, prev, cur);
+            return true;
+        }
+    }
+
+    bool contains(const Key& key) const {
+        reclaim::epoch::guard guard;
+        return lookup(key) != nullptr;
+    }
+
+    // Copies the value into value, returns false if key is not present.
+    bool get(const Key& key, Value& value) const {
+        reclaim::epoch::guard guard;
+        node* n = lookup(key);
+        if (!n)
+            return false;
+        value = *n->_value.load(std::memory_order_acquire);
+        return true;
+    }
+
+    Value get(const Key& key) const {
+        Value value = Value();
+        get(key, value);
+        return value;
+    }
+
+    int size() const {
+        reclaim::epoch::guard guard;
+        int size = 0;
+        for (node* cur = _head.load(std::memory_order_acquire); cur; ) {
+            node* next = cur->_next.load(std::memory_order_acquire);
+            if (!is_marked(next))
+                ++size;
+            cur = unmarked(next);
+        }
+        return size;
+    }
+
+    bool empty() const {
+        return size() == 0;
+    }
+
+    // In key order.
+    std::list<std::pair<Key, Value>> get_list() const {
+        reclaim::epoch::guard guard;
+        std::list<std::pair<Key, Value>> list;
+        for (node* cur = _head.load(std::memory_order_acquire); cur; ) {
+            node* next = cur->_next.load(std::memory_order_acquire);
+            if (!is_marked(next))
+                list.emplace_back(cur->_key, *cur->_value.load(std::memory_order_acquire));
+            cur = unmarked(next);
+        }
+        return list;
+    }
+
+    void clear() {
+        reclaim::epoch::guard guard;
+        while (node* first = _head.load(std::memory_order_acquire))
+            erase(first->_key);
+    }
+};
+}// lock_free
+}// ts
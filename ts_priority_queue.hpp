@@ -0,0 +1,206 @@
+#pragma once
+
+#include <iostream>
+#include <atomic>
+#include <algorithm>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include "ts_backoff.hpp"
+#include "ts_wait_policy.hpp"
+
+namespace ts {
+
+// Relaxed concurrent priority queue (MultiQueue).
+// Items are spread over queue_num binary heaps, each with its own lock.
+// push goes to a random heap; try_pop_min looks at the tops of two random
+// heaps and pops from the one with the smaller top. The popped item is not
+// always the global minimum, but close to it, and contention is spread over
+// all heaps. queue_num is the strictness knob: 1 gives an exact priority
+// queue, more heaps give more throughput and looser ordering.
+// Priorities are read racily through each heap's published top, so Priority
+// has to be trivially copyable.
+// Wait is the waiting policy of wait_and_pop, see ts_wait_policy.hpp.
+template < class T, class Priority = int, class Compare = std::less<Priority>,
+           class Wait = wait::spin_then_park<0> >
+class priority_queue {
+private:
+    static_assert(std::is_trivially_copyable<Priority>::value,
+                  "priority_queue requires a trivially copyable Priority");
+    static_assert(wait::notifies_unlocked<Wait>::value,
+                  "priority_queue counts items outside the wait lock, Wait would miss wakeups");
+
+    static constexpr std::size_t _cache_line_size = 64;
+
+    struct entry {
+        Priority priority;
+        T data;
+    };
+
+    struct alignas(_cache_line_size) heap {
+        std::mutex _m;
+        std::vector<entry> _data;
+        // Published under _m for lock-free peeking.
+        std::atomic<Priority> _top;
+        std::atomic<int> _size;
+        heap(): _top(Priority()), _size(0) { }
+    };
+
+    const std::size_t _queue_num;
+    std::unique_ptr<heap[]> _heaps;
+    Compare _compare;
+    alignas(_cache_line_size) std::atomic<int> _size;
+    alignas(_cache_line_size) std::mutex _wait_m;
+    Wait _cond;
+
+    // std heap functions build a max heap, so invert the comparison.
+    bool entry_after(const entry& a, const entry& b) const {
+        return _compare(b.priority, a.priority);
+    }
+
+    void publish(heap& h) {
+        if (!h._data.empty())
+            h._top.store(h._data.front().priority, std::memory_order_relaxed);
+        h._size.store(static_cast<int>(h._data.size()), std::memory_order_relaxed);
+    }
+
+    heap& random_heap() {
+        return _heaps[thread_random() % _queue_num];
+    }
+
+    // Lock a random heap, trying a few others before blocking on one.
+    std::unique_lock<std::mutex> lock_random_heap(heap*& h) {
+        for (int i = 0; i < 4; ++i) {
+            h = &random_heap();
+            std::unique_lock<std::mutex> l(h->_m, std::try_to_lock);
+            if (l.owns_lock())
+                return l;
+        }
+        h = &random_heap();
+        return std::unique_lock<std::mutex>(h->_m);
+    }
+
+    std::optional<T> pop_from(heap& h, bool blocking) {
+        if (!h._size.load(std::memory_order_relaxed))
+            return std::nullopt;
+        std::optional<T> data;
+        {
+            std::unique_lock<std::mutex> l(h._m, std::defer_lock);
+            if (blocking)
+                l.lock();
+            else if (!l.try_lock())
+                return std::nullopt;
+            if (h._data.empty())
+                return std::nullopt;
+            std::pop_heap(h._data.begin(), h._data.end(),
+                          [this](const entry& a, const entry& b) { return entry_after(a, b); });
+            data.emplace(std::move(h._data.back().data));
+            h._data.pop_back();
+            publish(h);
+        }
+        _size.fetch_sub(1, std::memory_order_relaxed);
+        return data;
+    }
+
+    // Returns the heap with the better top, nullptr if both look empty.
+    heap* better_heap(heap& a, heap& b) const {
+        bool a_empty = !a._size.load(std::memory_order_relaxed);
+        bool b_empty = !b._size.load(std::memory_order_relaxed);
+        if (a_empty)
+            return b_empty ? nullptr : &b;
+        if (b_empty)
+            return &a;
+        return _compare(b._top.load(std::memory_order_relaxed),
+                        a._top.load(std::memory_order_relaxed)) ? &b : &a;
+    }
+
+    // Returns nullopt only after finding every heap empty.
+    std::optional<T> pop_min() {
+        if (_queue_num > 1) {
+            for (int i = 0; i < 2; ++i) {
+                heap* h = better_heap(random_heap(), random_heap());
+                if (!h)
+                    continue;
+                if (auto data = pop_from(*h, false))
+                    return data;
+            }
+        }
+
+        std::size_t start = thread_random() % _queue_num;
+        for (std::size_t i = 0; i < _queue_num; ++i) {
+            if (auto data = pop_from(_heaps[(start + i) % _queue_num], true))
+                return data;
+        }
+        return std::nullopt;
+    }
+
+    T wait_pop() {
+        while (true) {
+            if (auto data = pop_min())
+                return std::move(*data);
+            std::unique_lock<std::mutex> l(_wait_m);
+            _cond.wait(l, [this] { return _size.load(std::memory_order_seq_cst) > 0; });
+        }
+    }
+
+public:
+    explicit priority_queue(std::size_t queue_num = 2 * std::thread::hardware_concurrency())
+        : _queue_num(queue_num ? queue_num : 1),
+          _heaps(new heap[_queue_num]),
+          _size(0) { }
+    priority_queue(const priority_queue&) = delete;
+    priority_queue& operator=(const priority_queue&) = delete;
+
+    void push(Priority priority, T data) {
+        {
+            heap* h;
+            auto l = lock_random_heap(h);
+            h->_data.push_back(entry{ priority, std::move(data) });
+            std::push_heap(h->_data.begin(), h->_data.end(),
+                           [this](const entry& a, const entry& b) { return entry_after(a, b); });
+            publish(*h);
+        }
+        _size.fetch_add(1, std::memory_order_seq_cst);
+        _cond.notify_one();
+    }
+
+    // Pop an item with a small priority, exactly the smallest if queue_num
+    // is 1. Returns false only after finding every heap empty.
+    bool try_pop_min(T& data) {
+        auto item = pop_min();
+        if (!item)
+            return false;
+        data = std::move(*item);
+        return true;
+    }
+
+    std::shared_ptr<T> try_pop_min() {
+        auto item = pop_min();
+        return item ? std::make_shared<T>(std::move(*item)) : nullptr;
+    }
+
+    void wait_and_pop(T& data) {
+        data = wait_pop();
+    }
+
+    std::shared_ptr<T> wait_and_pop() {
+        return std::make_shared<T>(wait_pop());
+    }
+
+    bool empty() const {
+        return size() == 0;
+    }
+
+    int size() const {
+        // A pop can take an item from its heap before push has counted it.
+        return std::max(0, _size.load(std::memory_order_relaxed));
+    }
+
+    std::size_t queue_num() const { return _queue_num; }
+};
+}// ts
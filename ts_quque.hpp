@@ -1,9 +1,16 @@
+#pragma once
+
 #include <iostream>
 #include <queue>
 #include <mutex>
+#include <condition_variable>
 #include <memory>
+#include <chrono>
 
-template < class T >
+#include "ts_wait_policy.hpp"
+
+// Wait is the waiting policy of wait_and_pop, see ts_wait_policy.hpp.
+template < class T, class Wait = ts::wait::blocking >
 class ts_queue {
 public:
     inline ts_queue() {}
@@ -31,7 +38,7 @@ public:
 
     inline std::shared_ptr<T> pop() {
         std::lock_guard<std::mutex> m(this->_m);
-        if (_data.empty()) return false;
+        if (_data.empty()) return std::shared_ptr<T>();
         auto item = std::make_shared<T>(std::move(_data.front()));
         _data.pop();
         return item;
@@ -53,6 +60,9 @@ public:
         return item;
     }
 
+    // The waiting policy, e.g. to reach the notifier of wait::readiness.
+    inline Wait& wait_policy() { return _data_con; }
+
     inline bool empty() const {
         std::lock_guard<std::mutex> m(this->_m);
         return _data.empty();
@@ -65,11 +75,148 @@ public:
 
     inline void clear() {
         std::lock_guard<std::mutex> m(this->_m);
-        _data.swap(std::queue<std::string>());
+        std::queue<T>().swap(_data);
     }
 
 private:
     mutable std::mutex _m;
     std::queue<T> _data;
-    std::condition_variable _data_con;
-};
\ No newline at end of file
+    Wait _data_con;
+};
+
+// Capacity bounded variant of ts_queue. Producers block (or fail, or time
+// out) while the queue is full, so a stalled consumer throttles them here
+// instead of letting the queue grow.
+// close() wakes every waiter: pushes fail from then on, pops drain what is
+// left and fail once the queue is empty.
+template < class T >
+class ts_bounded_queue {
+public:
+    explicit ts_bounded_queue(std::size_t capacity)
+        : _capacity(capacity ? capacity : 1), _closed(false) {}
+    ts_bounded_queue(const ts_bounded_queue&) = delete;
+    ts_bounded_queue& operator=(const ts_bounded_queue&) = delete;
+
+    // Returns false if the queue was closed. item is only moved from on success.
+    template < class U >
+    inline bool wait_and_push(U&& item) {
+        std::unique_lock<std::mutex> m(this->_m);
+        this->_not_full.wait(m, [this] { return can_push(); });
+        return enqueue(m, std::forward<U>(item));
+    }
+
+    template < class U >
+    inline bool try_push(U&& item) {
+        std::unique_lock<std::mutex> m(this->_m);
+        return enqueue(m, std::forward<U>(item));
+    }
+
+    template < class U, class Rep, class Period >
+    inline bool push_for(U&& item, const std::chrono::duration<Rep, Period>& timeout) {
+        std::unique_lock<std::mutex> m(this->_m);
+        this->_not_full.wait_for(m, timeout, [this] { return can_push(); });
+        return enqueue(m, std::forward<U>(item));
+    }
+
+    inline bool pop(T& item) {
+        std::unique_lock<std::mutex> m(this->_m);
+        return dequeue(m, item);
+    }
+
+    inline std::shared_ptr<T> pop() {
+        std::unique_lock<std::mutex> m(this->_m);
+        return dequeue(m);
+    }
+
+    // Returns false (nullptr) only if the queue is closed and empty.
+    inline bool wait_and_pop(T& item) {
+        std::unique_lock<std::mutex> m(this->_m);
+        this->_not_empty.wait(m, [this] { return can_pop(); });
+        return dequeue(m, item);
+    }
+
+    inline std::shared_ptr<T> wait_and_pop() {
+        std::unique_lock<std::mutex> m(this->_m);
+        this->_not_empty.wait(m, [this] { return can_pop(); });
+        return dequeue(m);
+    }
+
+    template < class Rep, class Period >
+    inline bool pop_for(T& item, const std::chrono::duration<Rep, Period>& timeout) {
+        std::unique_lock<std::mutex> m(this->_m);
+        this->_not_empty.wait_for(m, timeout, [this] { return can_pop(); });
+        return dequeue(m, item);
+    }
+
+    template < class Rep, class Period >
+    inline std::shared_ptr<T> pop_for(const std::chrono::duration<Rep, Period>& timeout) {
+        std::unique_lock<std::mutex> m(this->_m);
+        this->_not_empty.wait_for(m, timeout, [this] { return can_pop(); });
+        return dequeue(m);
+    }
+
+    inline void close() {
+        {
+            std::lock_guard<std::mutex> m(this->_m);
+            _closed = true;
+        }
+        _not_empty.notify_all();
+        _not_full.notify_all();
+    }
+
+    inline bool closed() const {
+        std::lock_guard<std::mutex> m(this->_m);
+        return _closed;
+    }
+
+    inline bool empty() const {
+        std::lock_guard<std::mutex> m(this->_m);
+        return _data.empty();
+    }
+
+    inline int size() const {
+        std::lock_guard<std::mutex> m(this->_m);
+        return _data.size();
+    }
+
+    inline std::size_t capacity() const { return _capacity; }
+
+private:
+    bool can_push() const { return _closed || _data.size() < _capacity; }
+    bool can_pop() const { return _closed || !_data.empty(); }
+
+    // _m must be held by m.
+    template < class U >
+    bool enqueue(std::unique_lock<std::mutex>& m, U&& item) {
+        if (_closed || _data.size() >= _capacity) return false;
+        _data.push(std::forward<U>(item));
+        m.unlock();
+        _not_empty.notify_one();
+        return true;
+    }
+
+    bool dequeue(std::unique_lock<std::mutex>& m, T& item) {
+        if (_data.empty()) return false;
+        item = std::move(_data.front());
+        _data.pop();
+        m.unlock();
+        _not_full.notify_one();
+        return true;
+    }
+
+    std::shared_ptr<T> dequeue(std::unique_lock<std::mutex>& m) {
+        if (_data.empty()) return std::shared_ptr<T>();
+        auto item = std::make_shared<T>(std::move(_data.front()));
+        _data.pop();
+        m.unlock();
+        _not_full.notify_one();
+        return item;
+    }
+
+    const std::size_t _capacity;
+    mutable std::mutex _m;
+    std::queue<T> _data;
+    bool _closed;
+    std::condition_variable _not_empty;
+    std::condition_variable _not_full;
+};
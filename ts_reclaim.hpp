@@ -0,0 +1,403 @@
+#pragma once
+
+#include <iostream>
+#include <atomic>
+#include <mutex>
+#include <vector>
+#include <algorithm>
+#include <cstdint>
+
+namespace ts {
+
+// Hazard pointer domain.
+// A thread publishes the pointer it is about to dereference in one of its
+// hazard slots. Retired nodes are kept in a per-thread list, and once the
+// list grows past a threshold proportional to the number of slots the thread
+// frees everything no slot points to. Lists left behind by exiting threads
+// are adopted by the next thread that scans.
+class hazard_pointer_domain {
+public:
+    typedef void (*deleter)(void*);
+
+    struct record {
+        std::atomic<void*> _hazard;
+        std::atomic<bool> _active;
+        record* _next;
+        record(): _hazard(nullptr), _active(true), _next(nullptr) { }
+    };
+
+private:
+    struct retired {
+        void* _ptr;
+        deleter _deleter;
+    };
+
+    struct thread_state {
+        std::vector<record*> _free_records;
+        std::vector<retired> _retired;
+        thread_state() { hazard_pointer_domain::instance(); }
+        ~thread_state() {
+            auto& domain = hazard_pointer_domain::instance();
+            for (auto r : _free_records)
+                r->_active.store(false, std::memory_order_release);
+            if (!_retired.empty())
+                domain.scan(_retired);
+            if (!_retired.empty()) {
+                std::lock_guard<std::mutex> l(domain._orphan_m);
+                domain._orphans.insert(domain._orphans.end(), _retired.begin(), _retired.end());
+            }
+        }
+    };
+
+    static constexpr std::size_t _min_scan_threshold = 64;
+
+    std::atomic<record*> _records;
+    std::atomic<std::size_t> _record_num;
+    std::mutex _orphan_m;
+    std::vector<retired> _orphans;
+
+    hazard_pointer_domain(): _records(nullptr), _record_num(0) { }
+
+    static thread_state& local() {
+        thread_local thread_state state;
+        return state;
+    }
+
+    void scan(std::vector<retired>& list) {
+        {
+            std::unique_lock<std::mutex> l(_orphan_m, std::try_to_lock);
+            if (l && !_orphans.empty()) {
+                list.insert(list.end(), _orphans.begin(), _orphans.end());
+                _orphans.clear();
+            }
+        }
+
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        std::vector<void*> hazards;
+        for (record* r = _records.load(std::memory_order_acquire); r; r = r->_next) {
+            if (void* p = r->_hazard.load(std::memory_order_acquire))
+                hazards.push_back(p);
+        }
+        std::sort(hazards.begin(), hazards.end());
+
+        auto keep = std::partition(list.begin(), list.end(), [&](const retired& item) {
+            return std::binary_search(hazards.begin(), hazards.end(), item._ptr);
+        });
+        std::vector<retired> reclaimable(keep, list.end());
+        list.erase(keep, list.end());
+        for (auto& item : reclaimable)
+            item._deleter(item._ptr);
+    }
+
+public:
+    hazard_pointer_domain(const hazard_pointer_domain&) = delete;
+    hazard_pointer_domain& operator=(const hazard_pointer_domain&) = delete;
+    // Runs at exit when no thread can hold a hazard pointer any more.
+    ~hazard_pointer_domain() {
+        for (auto& item : _orphans)
+            item._deleter(item._ptr);
+        record* r = _records.load();
+        while (r) {
+            record* next = r->_next;
+            delete r;
+            r = next;
+        }
+    }
+
+    static hazard_pointer_domain& instance() {
+        static hazard_pointer_domain domain;
+        return domain;
+    }
+
+    record* acquire_record() {
+        auto& state = local();
+        if (!state._free_records.empty()) {
+            record* r = state._free_records.back();
+            state._free_records.pop_back();
+            return r;
+        }
+
+        for (record* r = _records.load(std::memory_order_acquire); r; r = r->_next) {
+            bool active = false;
+            if (!r->_active.load(std::memory_order_relaxed) &&
+                r->_active.compare_exchange_strong(active, true, std::memory_order_acquire))
+                return r;
+        }
+
+        record* r = new record;
+        r->_next = _records.load(std::memory_order_relaxed);
+        while (!_records.compare_exchange_weak(r->_next, r, std::memory_order_release,
+                                               std::memory_order_relaxed));
+        ++_record_num;
+        return r;
+    }
+
+    // Records stay owned by the thread until it exits.
+    void release_record(record* r) {
+        r->_hazard.store(nullptr, std::memory_order_release);
+        local()._free_records.push_back(r);
+    }
+
+    void retire(void* ptr, deleter d) {
+        auto& list = local()._retired;
+        list.push_back({ ptr, d });
+        if (list.size() >= std::max(_min_scan_threshold, 2 * _record_num.load(std::memory_order_relaxed)))
+            scan(list);
+    }
+};
+
+// RAII owner of hazard slots, each slot protects one pointer.
+class hazard_pointer {
+public:
+    static constexpr int _max_slots = 2;
+
+private:
+    hazard_pointer_domain::record* _records[_max_slots];
+
+    hazard_pointer_domain::record* get_record(int slot) {
+        if (!_records[slot])
+            _records[slot] = hazard_pointer_domain::instance().acquire_record();
+        return _records[slot];
+    }
+
+public:
+    hazard_pointer(): _records() { }
+    ~hazard_pointer() {
+        for (auto r : _records) {
+            if (r)
+                hazard_pointer_domain::instance().release_record(r);
+        }
+    }
+    hazard_pointer(const hazard_pointer&) = delete;
+    hazard_pointer& operator=(const hazard_pointer&) = delete;
+
+    // Publish the current value of src and return it once it is known that
+    // src still held it after publishing.
+    template < class P >
+    P* protect(const std::atomic<P*>& src, int slot = 0) {
+        auto r = get_record(slot);
+        P* ptr = src.load(std::memory_order_relaxed);
+        while (true) {
+            r->_hazard.store(ptr, std::memory_order_seq_cst);
+            P* current = src.load(std::memory_order_seq_cst);
+            if (current == ptr)
+                return ptr;
+            ptr = current;
+        }
+    }
+
+    // Publish ptr as is for sources protect() cannot read (e.g. a counted
+    // pointer). The caller re-reads the source afterwards and only trusts ptr
+    // if it still holds it.
+    void publish(const void* ptr, int slot = 0) {
+        get_record(slot)->_hazard.store(const_cast<void*>(ptr), std::memory_order_seq_cst);
+    }
+
+    void reset(int slot = 0) {
+        if (_records[slot])
+            _records[slot]->_hazard.store(nullptr, std::memory_order_release);
+    }
+};
+
+// Epoch based reclamation.
+// A thread announces the global epoch while it is inside a critical section.
+// Retired nodes are tagged with the epoch they were retired in, and the global
+// epoch only advances once every active thread has announced it, so a node
+// retired in epoch e is unreachable for everybody once the epoch reaches e + 2.
+// Readers pay one announce per operation instead of protecting every node.
+class epoch_domain {
+public:
+    typedef void (*deleter)(void*);
+
+    struct record {
+        // (epoch << 1) | 1 while active, 0 while quiescent.
+        std::atomic<std::uint64_t> _epoch;
+        std::atomic<bool> _used;
+        record* _next;
+        record(): _epoch(0), _used(true), _next(nullptr) { }
+    };
+
+private:
+    struct retired {
+        void* _ptr;
+        deleter _deleter;
+        std::uint64_t _epoch;
+    };
+
+    struct thread_state {
+        record* _record;
+        int _nesting;
+        std::size_t _retired_since_collect;
+        std::vector<retired> _retired;
+        thread_state()
+            : _record(epoch_domain::instance().acquire_record()),
+              _nesting(0), _retired_since_collect(0) { }
+        ~thread_state() {
+            auto& domain = epoch_domain::instance();
+            domain.collect(_retired);
+            if (!_retired.empty()) {
+                std::lock_guard<std::mutex> l(domain._orphan_m);
+                domain._orphans.insert(domain._orphans.end(), _retired.begin(), _retired.end());
+            }
+            _record->_epoch.store(0, std::memory_order_release);
+            _record->_used.store(false, std::memory_order_release);
+        }
+    };
+
+    static constexpr std::size_t _collect_threshold = 64;
+
+    std::atomic<std::uint64_t> _global_epoch;
+    std::atomic<record*> _records;
+    std::mutex _orphan_m;
+    std::vector<retired> _orphans;
+
+    epoch_domain(): _global_epoch(1), _records(nullptr) { }
+
+    static thread_state& local() {
+        thread_local thread_state state;
+        return state;
+    }
+
+    record* acquire_record() {
+        for (record* r = _records.load(std::memory_order_acquire); r; r = r->_next) {
+            bool used = false;
+            if (!r->_used.load(std::memory_order_relaxed) &&
+                r->_used.compare_exchange_strong(used, true, std::memory_order_acquire))
+                return r;
+        }
+
+        record* r = new record;
+        r->_next = _records.load(std::memory_order_relaxed);
+        while (!_records.compare_exchange_weak(r->_next, r, std::memory_order_release,
+                                               std::memory_order_relaxed));
+        return r;
+    }
+
+    // Advance the global epoch if every active thread has caught up with it.
+    std::uint64_t try_advance() {
+        std::uint64_t epoch = _global_epoch.load(std::memory_order_seq_cst);
+        for (record* r = _records.load(std::memory_order_acquire); r; r = r->_next) {
+            std::uint64_t announced = r->_epoch.load(std::memory_order_seq_cst);
+            if ((announced & 1) && (announced >> 1) != epoch)
+                return epoch;
+        }
+        if (_global_epoch.compare_exchange_strong(epoch, epoch + 1, std::memory_order_seq_cst))
+            return epoch + 1;
+        return epoch;
+    }
+
+    void collect(std::vector<retired>& list) {
+        {
+            std::unique_lock<std::mutex> l(_orphan_m, std::try_to_lock);
+            if (l && !_orphans.empty()) {
+                list.insert(list.end(), _orphans.begin(), _orphans.end());
+                _orphans.clear();
+            }
+        }
+
+        std::uint64_t epoch = try_advance();
+        auto keep = std::partition(list.begin(), list.end(), [epoch](const retired& item) {
+            return item._epoch + 2 > epoch;
+        });
+        std::vector<retired> reclaimable(keep, list.end());
+        list.erase(keep, list.end());
+        for (auto& item : reclaimable)
+            item._deleter(item._ptr);
+    }
+
+public:
+    epoch_domain(const epoch_domain&) = delete;
+    epoch_domain& operator=(const epoch_domain&) = delete;
+    // Runs at exit when no thread can be inside a critical section any more.
+    ~epoch_domain() {
+        for (auto& item : _orphans)
+            item._deleter(item._ptr);
+        record* r = _records.load();
+        while (r) {
+            record* next = r->_next;
+            delete r;
+            r = next;
+        }
+    }
+
+    static epoch_domain& instance() {
+        static epoch_domain domain;
+        return domain;
+    }
+
+    // Critical sections nest, only the outermost one announces.
+    void enter() {
+        auto& state = local();
+        if (state._nesting++)
+            return;
+        std::uint64_t epoch = _global_epoch.load(std::memory_order_seq_cst);
+        while (true) {
+            state._record->_epoch.store((epoch << 1) | 1, std::memory_order_seq_cst);
+            // The epoch may have moved on before the announcement was visible.
+            std::uint64_t current = _global_epoch.load(std::memory_order_seq_cst);
+            if (current == epoch)
+                break;
+            epoch = current;
+        }
+    }
+
+    void exit() {
+        auto& state = local();
+        if (!--state._nesting)
+            state._record->_epoch.store(0, std::memory_order_release);
+    }
+
+    void retire(void* ptr, deleter d) {
+        auto& state = local();
+        state._retired.push_back({ ptr, d, _global_epoch.load(std::memory_order_seq_cst) });
+        if (++state._retired_since_collect >= _collect_threshold) {
+            state._retired_since_collect = 0;
+            collect(state._retired);
+        }
+    }
+};
+
+namespace reclaim {
+
+// Split external/internal reference counting built into the container itself.
+struct ref_count { };
+
+// Containers take a guard for the duration of an operation, protect the
+// nodes they dereference through it and hand unlinked nodes to retire().
+struct hazard_pointer {
+    typedef ts::hazard_pointer guard;
+
+    template < class P >
+    static void retire(P* ptr) {
+        hazard_pointer_domain::instance().retire(ptr, [](void* p) {
+            delete static_cast<P*>(p);
+        });
+    }
+};
+
+// The guard is an epoch critical section, protect() is a plain load.
+struct epoch {
+    class guard {
+    public:
+        guard() { epoch_domain::instance().enter(); }
+        ~guard() { epoch_domain::instance().exit(); }
+        guard(const guard&) = delete;
+        guard& operator=(const guard&) = delete;
+
+        template < class P >
+        P* protect(const std::atomic<P*>& src, int = 0) {
+            return src.load(std::memory_order_acquire);
+        }
+
+        void reset(int = 0) { }
+    };
+
+    template < class P >
+    static void retire(P* ptr) {
+        epoch_domain::instance().retire(ptr, [](void* p) {
+            delete static_cast<P*>(p);
+        });
+    }
+};
+}// reclaim
+}// ts
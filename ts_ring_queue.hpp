@@ -0,0 +1,176 @@
+#pragma once
+
+#include <iostream>
+#include <atomic>
+#include <memory>
+#include <new>
+#include <thread>
+#include <cstdint>
+#include <type_traits>
+
+namespace ts {
+namespace lock_free {
+
+// Bounded multi-producer/multi-consumer queue.
+// Every slot carries a sequence number telling producers and consumers whose
+// turn it is, so a push or pop is a single CAS on the enqueue/dequeue position
+// and the items live inline in a power-of-two array (no allocation after
+// construction).
+template < class T >
+class ring_queue {
+private:
+    static_assert(std::is_nothrow_move_constructible<T>::value,
+                  "ring_queue requires T to be nothrow move constructible");
+
+    static constexpr std::size_t _cache_line_size = 64;
+
+    struct cell {
+        std::atomic<std::size_t> _sequence;
+        typename std::aligned_storage<sizeof(T), alignof(T)>::type _storage;
+
+        T* data() { return std::launder(reinterpret_cast<T*>(&_storage)); }
+    };
+
+    static std::size_t round_up_capacity(std::size_t capacity) {
+        std::size_t size = 2;
+        while (size < capacity)
+            size <<= 1;
+        return size;
+    }
+
+private:
+    const std::size_t _mask;
+    std::unique_ptr<cell[]> _cells;
+    // Producers and consumers hammer different positions, keep them apart.
+    alignas(_cache_line_size) std::atomic<std::size_t> _enqueue_pos;
+    alignas(_cache_line_size) std::atomic<std::size_t> _dequeue_pos;
+
+    cell* acquire_push_cell(std::size_t& pos) {
+        pos = _enqueue_pos.load(std::memory_order_relaxed);
+        while (true) {
+            cell* c = &_cells[pos & _mask];
+            std::size_t seq = c->_sequence.load(std::memory_order_acquire);
+            auto diff = static_cast<std::intptr_t>(seq) - static_cast<std::intptr_t>(pos);
+            if (diff == 0) {
+                if (_enqueue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                    return c;
+            }
+            else if (diff < 0) {
+                return nullptr; // full
+            }
+            else {
+                pos = _enqueue_pos.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    cell* acquire_pop_cell(std::size_t& pos) {
+        pos = _dequeue_pos.load(std::memory_order_relaxed);
+        while (true) {
+            cell* c = &_cells[pos & _mask];
+            std::size_t seq = c->_sequence.load(std::memory_order_acquire);
+            auto diff = static_cast<std::intptr_t>(seq) - static_cast<std::intptr_t>(pos + 1);
+            if (diff == 0) {
+                if (_dequeue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                    return c;
+            }
+            else if (diff < 0) {
+                return nullptr; // empty
+            }
+            else {
+                pos = _dequeue_pos.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+public:
+    // capacity is rounded up to the next power of two.
+    explicit ring_queue(std::size_t capacity = 1024)
+        : _mask(round_up_capacity(capacity) - 1),
+          _cells(new cell[_mask + 1]),
+          _enqueue_pos(0), _dequeue_pos(0) {
+        for (std::size_t i = 0; i <= _mask; ++i)
+            _cells[i]._sequence.store(i, std::memory_order_relaxed);
+    }
+    // Make sure no thread now is accessing current queue instance
+    ~ring_queue() {
+        std::size_t pos;
+        while (cell* c = acquire_pop_cell(pos))
+            c->data()->~T();
+    }
+    ring_queue(const ring_queue&) = delete;
+    ring_queue& operator=(const ring_queue&) = delete;
+
+    bool try_push(T data) {
+        std::size_t pos;
+        cell* c = acquire_push_cell(pos);
+        if (!c)
+            return false;
+        new (&c->_storage) T(std::move(data));
+        c->_sequence.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Spin (yielding) while the queue is full.
+    void push(T data) {
+        std::size_t pos;
+        cell* c;
+        while (!(c = acquire_push_cell(pos)))
+            std::this_thread::yield();
+        new (&c->_storage) T(std::move(data));
+        c->_sequence.store(pos + 1, std::memory_order_release);
+    }
+
+    bool try_pop(T& data) {
+        std::size_t pos;
+        cell* c = acquire_pop_cell(pos);
+        if (!c)
+            return false;
+        // Only the nothrow move construction happens before the slot is
+        // handed back, a throwing assignment must not stall the ring.
+        T value(std::move(*c->data()));
+        c->data()->~T();
+        c->_sequence.store(pos + _mask + 1, std::memory_order_release);
+        data = std::move(value);
+        return true;
+    }
+
+    std::shared_ptr<T> try_pop() {
+        std::size_t pos;
+        cell* c = acquire_pop_cell(pos);
+        if (!c)
+            return nullptr;
+        T value(std::move(*c->data()));
+        c->data()->~T();
+        c->_sequence.store(pos + _mask + 1, std::memory_order_release);
+        return std::make_shared<T>(std::move(value));
+    }
+
+    void wait_and_pop(T& data) {
+        while (!try_pop(data))
+            std::this_thread::yield();
+    }
+
+    std::shared_ptr<T> wait_and_pop() {
+        std::shared_ptr<T> data;
+        while (!(data = try_pop()))
+            std::this_thread::yield();
+        return data;
+    }
+
+    bool empty() const {
+        return size() == 0;
+    }
+
+    int size() const {
+        auto enqueue_pos = _enqueue_pos.load(std::memory_order_acquire);
+        auto dequeue_pos = _dequeue_pos.load(std::memory_order_acquire);
+        // Pops between the two loads can put dequeue_pos ahead.
+        auto diff = static_cast<std::intptr_t>(enqueue_pos - dequeue_pos);
+        return diff > 0 ? static_cast<int>(diff) : 0;
+    }
+
+    std::size_t capacity() const { return _mask + 1; }
+};
+}// lock_free
+}// ts
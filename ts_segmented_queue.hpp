@@ -0,0 +1,213 @@
+#pragma once
+
+#include <iostream>
+#include <atomic>
+#include <memory>
+#include <new>
+#include <optional>
+#include <type_traits>
+
+#include "ts_backoff.hpp"
+#include "ts_node_pool.hpp"
+#include "ts_reclaim.hpp"
+
+namespace ts {
+namespace lock_free {
+
+// Unbounded MPMC queue made of linked fixed-size array segments.
+// push and pop claim a cell with one fetch_add on the segment's enqueue or
+// dequeue index instead of retrying a CAS on a shared pointer, so under
+// contention most operations finish without a retry. A consumer that gets to a
+// cell before its producer marks it taken; the producer then retries on a
+// later cell. Only moving to a new segment takes a CAS. Retired segments are
+// protected by hazard pointers and recycled through node_pool.
+template < class T, std::size_t SegmentSize = 256 >
+class segmented_queue {
+private:
+    static_assert(std::is_nothrow_move_constructible<T>::value,
+                  "segmented_queue requires a nothrow move constructible T");
+
+    static constexpr std::size_t _cache_line_size = 64;
+    // How long a consumer waits for a producer that already claimed its cell.
+    static constexpr int _fill_spins = 64;
+
+    enum { cell_empty, cell_full, cell_taken };
+
+    struct cell {
+        std::atomic<int> _state;
+        typename std::aligned_storage<sizeof(T), alignof(T)>::type _storage;
+        cell(): _state(cell_empty) { }
+        T* data() { return std::launder(reinterpret_cast<T*>(&_storage)); }
+    };
+
+    struct segment {
+        alignas(_cache_line_size) std::atomic<std::size_t> _enq_idx;
+        alignas(_cache_line_size) std::atomic<std::size_t> _deq_idx;
+        alignas(_cache_line_size) std::atomic<segment*> _next;
+        cell _cells[SegmentSize];
+
+        segment(): _enq_idx(0), _deq_idx(0), _next(nullptr) { }
+        ~segment() {
+            for (auto& c : _cells) {
+                if (c._state.load(std::memory_order_relaxed) == cell_full)
+                    c.data()->~T();
+            }
+        }
+    };
+    typedef node_pool<segment> pool;
+
+    static segment* new_segment() {
+        return new (pool::allocate()) segment;
+    }
+    static void delete_segment(segment* s) {
+        s->~segment();
+        pool::deallocate(s);
+    }
+    static void retire_segment(segment* s) {
+        hazard_pointer_domain::instance().retire(s, [](void* p) {
+            delete_segment(static_cast<segment*>(p));
+        });
+    }
+
+    alignas(_cache_line_size) std::atomic<segment*> _head;
+    alignas(_cache_line_size) std::atomic<segment*> _tail;
+
+    // Link a new segment holding data after tail. On failure data is handed
+    // back untouched.
+    bool append_segment(segment* tail, T& data) {
+        segment* s = new_segment();
+        cell& first = s->_cells[0];
+        new (&first._storage) T(std::move(data));
+        first._state.store(cell_full, std::memory_order_relaxed);
+        s->_enq_idx.store(1, std::memory_order_relaxed);
+
+        segment* next = nullptr;
+        if (tail->_next.compare_exchange_strong(next, s)) {
+            _tail.compare_exchange_strong(tail, s);
+            return true;
+        }
+        data = std::move(*first.data());
+        first.data()->~T();
+        first._state.store(cell_empty, std::memory_order_relaxed);
+        delete_segment(s);
+        return false;
+    }
+
+public:
+    segmented_queue() {
+        segment* s = new_segment();
+        _head.store(s);
+        _tail.store(s);
+    }
+    // Make sure no thread now is accessing current queue instance
+    ~segmented_queue() {
+        segment* cur = _head.load();
+        while (cur) {
+            segment* next = cur->_next.load();
+            delete_segment(cur);
+            cur = next;
+        }
+    }
+    segmented_queue(const segmented_queue&) = delete;
+    segmented_queue& operator=(const segmented_queue&) = delete;
+
+    void push(T data) {
+        ts::hazard_pointer guard;
+
+        while (true) {
+            segment* tail = guard.protect(_tail);
+            std::size_t idx = tail->_enq_idx.fetch_add(1);
+            if (idx < SegmentSize) {
+                cell& c = tail->_cells[idx];
+                new (&c._storage) T(std::move(data));
+                int state = cell_empty;
+                if (c._state.compare_exchange_strong(state, cell_full, std::memory_order_release,
+                                                     std::memory_order_relaxed))
+                    return;
+                // A consumer gave up on this cell, take the item back.
+                data = std::move(*c.data());
+                c.data()->~T();
+                continue;
+            }
+
+            // Segment is full, append a new one or help whoever did.
+            if (tail != _tail.load())
+                continue;
+            segment* next = tail->_next.load();
+            if (next) {
+                _tail.compare_exchange_strong(tail, next);
+                continue;
+            }
+            if (append_segment(tail, data))
+                return;
+        }
+    }
+
+private:
+    std::optional<T> pop_item() {
+        ts::hazard_pointer guard;
+
+        while (true) {
+            segment* head = guard.protect(_head);
+            if (head->_deq_idx.load() >= head->_enq_idx.load() && !head->_next.load())
+                return std::nullopt;
+
+            std::size_t idx = head->_deq_idx.fetch_add(1);
+            if (idx < SegmentSize) {
+                cell& c = head->_cells[idx];
+                if (idx < head->_enq_idx.load()) {
+                    for (int i = 0; i < _fill_spins &&
+                         c._state.load(std::memory_order_relaxed) == cell_empty; ++i)
+                        cpu_relax();
+                }
+                if (c._state.exchange(cell_taken, std::memory_order_acquire) == cell_full) {
+                    std::optional<T> data(std::move(*c.data()));
+                    c.data()->~T();
+                    return data;
+                }
+                continue;
+            }
+
+            // Segment is drained, move on to the next one.
+            segment* next = head->_next.load();
+            if (!next)
+                return std::nullopt;
+            // _tail must not point at a retired segment.
+            segment* tail = head;
+            _tail.compare_exchange_strong(tail, next);
+            if (_head.compare_exchange_strong(head, next)) {
+                guard.reset();
+                retire_segment(head);
+            }
+        }
+    }
+
+public:
+    bool try_pop(T& data) {
+        auto item = pop_item();
+        if (!item)
+            return false;
+        data = std::move(*item);
+        return true;
+    }
+
+    std::unique_ptr<T> pop() {
+        auto item = pop_item();
+        return item ? std::make_unique<T>(std::move(*item)) : std::unique_ptr<T>();
+    }
+
+    // A cell a producer has claimed but not filled yet already counts.
+    bool empty() {
+        ts::hazard_pointer guard;
+        segment* head = guard.protect(_head);
+        std::size_t idx = head->_deq_idx.load();
+        return (idx >= SegmentSize || idx >= head->_enq_idx.load()) && !head->_next.load();
+    }
+
+    // Number of segments ever requested from the global allocator.
+    static std::size_t allocated_segment_num() {
+        return pool::allocated_num();
+    }
+};
+}// lock_free
+}// ts
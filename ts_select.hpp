@@ -0,0 +1,139 @@
+#pragma once
+
+#include <iostream>
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+namespace ts {
+
+// Wakes one selecting thread whenever any of its queues gets an item.
+// The epoch lets a selector read the current state, scan its queues and then
+// sleep only if nothing was pushed since the read.
+class select_signal {
+private:
+    std::mutex _m;
+    std::condition_variable _cond;
+    std::uint64_t _epoch;
+
+public:
+    select_signal(): _epoch(0) { }
+
+    std::uint64_t epoch() {
+        std::lock_guard<std::mutex> l(_m);
+        return _epoch;
+    }
+
+    void wait(std::uint64_t epoch) {
+        std::unique_lock<std::mutex> l(_m);
+        _cond.wait(l, [this, epoch] { return _epoch != epoch; });
+    }
+
+    void notify() {
+        {
+            std::lock_guard<std::mutex> l(_m);
+            ++_epoch;
+        }
+        _cond.notify_all();
+    }
+};
+
+// Per-queue list of attached select_signals, notified after every push.
+// A queue without selectors pays one atomic load per push.
+class select_hook {
+private:
+    std::atomic<int> _signal_num;
+    std::mutex _m;
+    std::vector<select_signal*> _signals;
+
+public:
+    select_hook(): _signal_num(0) { }
+    select_hook(const select_hook&) = delete;
+    select_hook& operator=(const select_hook&) = delete;
+
+    void attach(select_signal* s) {
+        std::lock_guard<std::mutex> l(_m);
+        _signals.push_back(s);
+        _signal_num.fetch_add(1, std::memory_order_seq_cst);
+    }
+
+    void detach(select_signal* s) {
+        std::lock_guard<std::mutex> l(_m);
+        _signals.erase(std::remove(_signals.begin(), _signals.end(), s), _signals.end());
+        _signal_num.fetch_sub(1, std::memory_order_relaxed);
+    }
+
+    // Call after the item is visible to try_pop.
+    void notify() {
+        if (!_signal_num.load(std::memory_order_seq_cst))
+            return;
+        std::lock_guard<std::mutex> l(_m);
+        for (auto s : _signals)
+            s->notify();
+    }
+};
+
+enum class select_order {
+    priority,   // always prefer the queue with the lower index
+    round_robin // rotate the first queue looked at, so no queue starves
+};
+
+// Blocks one consumer thread on several queues at once, like select(2).
+// Queue needs try_pop(T&) and attach()/detach() of a select_signal, see
+// fine_tuned::queue. The queues must outlive the selector, and a selector is
+// meant to be used by one thread at a time.
+template < class Queue >
+class selector {
+private:
+    std::vector<Queue*> _queues;
+    select_order _order;
+    std::size_t _next;
+    select_signal _signal;
+
+public:
+    static constexpr std::size_t npos = static_cast<std::size_t>(-1);
+
+    explicit selector(std::vector<Queue*> queues, select_order order = select_order::priority)
+        : _queues(std::move(queues)), _order(order), _next(0) {
+        for (auto q : _queues)
+            q->attach(&_signal);
+    }
+    ~selector() {
+        for (auto q : _queues)
+            q->detach(&_signal);
+    }
+    selector(const selector&) = delete;
+    selector& operator=(const selector&) = delete;
+
+    // Returns the index of the queue data came from, npos if all were empty.
+    template < class T >
+    std::size_t try_pop(T& data) {
+        std::size_t count = _queues.size();
+        std::size_t start = _order == select_order::round_robin ? _next : 0;
+        for (std::size_t i = 0; i < count; ++i) {
+            std::size_t index = (start + i) % count;
+            if (_queues[index]->try_pop(data)) {
+                _next = (index + 1) % count;
+                return index;
+            }
+        }
+        return npos;
+    }
+
+    template < class T >
+    std::size_t wait_and_pop(T& data) {
+        while (true) {
+            std::uint64_t epoch = _signal.epoch();
+            std::size_t index = try_pop(data);
+            if (index != npos)
+                return index;
+            _signal.wait(epoch);
+        }
+    }
+
+    std::size_t size() const { return _queues.size(); }
+};
+}// ts
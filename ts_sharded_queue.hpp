@@ -0,0 +1,145 @@
+#pragma once
+
+#include <iostream>
+#include <atomic>
+#include <algorithm>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <thread>
+
+#include "ts_backoff.hpp"
+#include "ts_wait_policy.hpp"
+
+namespace ts {
+
+// Relaxed FIFO queue made of independent lanes.
+// A producer always pushes to the lane picked by its thread id, so producers
+// on different lanes never share a lock. A consumer samples two random lanes
+// and pops from the fuller one, falling back to a scan of all lanes. Items
+// from one producer stay in order, items from different producers don't.
+// Wait is the waiting policy of wait_and_pop, see ts_wait_policy.hpp.
+template < class T, class Wait = wait::spin_then_park<0> >
+class sharded_queue {
+private:
+    static_assert(wait::notifies_unlocked<Wait>::value,
+                  "sharded_queue counts items outside the wait lock, Wait would miss wakeups");
+
+    static constexpr std::size_t _cache_line_size = 64;
+
+    struct alignas(_cache_line_size) lane {
+        std::mutex _m;
+        std::deque<T> _data;
+        std::atomic<int> _size;
+        lane(): _size(0) { }
+    };
+
+    const std::size_t _lane_num;
+    std::unique_ptr<lane[]> _lanes;
+    alignas(_cache_line_size) std::atomic<int> _size;
+    alignas(_cache_line_size) std::mutex _wait_m;
+    Wait _cond;
+
+    lane& local_lane() {
+        thread_local std::size_t hash = std::hash<std::thread::id>()(std::this_thread::get_id());
+        return _lanes[hash % _lane_num];
+    }
+
+    std::optional<T> pop_lane(lane& l) {
+        if (!l._size.load(std::memory_order_relaxed))
+            return std::nullopt;
+        std::optional<T> data;
+        {
+            std::lock_guard<std::mutex> lk(l._m);
+            if (l._data.empty())
+                return std::nullopt;
+            data.emplace(std::move(l._data.front()));
+            l._data.pop_front();
+            l._size.fetch_sub(1, std::memory_order_relaxed);
+        }
+        _size.fetch_sub(1, std::memory_order_relaxed);
+        return data;
+    }
+
+    std::optional<T> pop_any() {
+        if (_lane_num > 1) {
+            lane& first = _lanes[thread_random() % _lane_num];
+            lane& second = _lanes[thread_random() % _lane_num];
+            lane& fuller = first._size.load(std::memory_order_relaxed) >=
+                           second._size.load(std::memory_order_relaxed) ? first : second;
+            if (auto data = pop_lane(fuller))
+                return data;
+        }
+
+        thread_local std::size_t cursor = 0;
+        for (std::size_t i = 0; i < _lane_num; ++i) {
+            if (auto data = pop_lane(_lanes[cursor++ % _lane_num]))
+                return data;
+        }
+        return std::nullopt;
+    }
+
+    T wait_pop() {
+        while (true) {
+            if (auto data = pop_any())
+                return std::move(*data);
+            std::unique_lock<std::mutex> lk(_wait_m);
+            _cond.wait(lk, [this] { return _size.load(std::memory_order_seq_cst) > 0; });
+        }
+    }
+
+public:
+    explicit sharded_queue(std::size_t lane_num = std::thread::hardware_concurrency())
+        : _lane_num(lane_num ? lane_num : 1),
+          _lanes(new lane[_lane_num]),
+          _size(0) { }
+    sharded_queue(const sharded_queue&) = delete;
+    sharded_queue& operator=(const sharded_queue&) = delete;
+
+    void push(T data) {
+        lane& l = local_lane();
+        {
+            std::lock_guard<std::mutex> lk(l._m);
+            l._data.push_back(std::move(data));
+            l._size.fetch_add(1, std::memory_order_relaxed);
+        }
+        _size.fetch_add(1, std::memory_order_seq_cst);
+        _cond.notify_one();
+    }
+
+    bool try_pop(T& data) {
+        auto item = pop_any();
+        if (!item)
+            return false;
+        data = std::move(*item);
+        return true;
+    }
+
+    std::shared_ptr<T> try_pop() {
+        auto item = pop_any();
+        return item ? std::make_shared<T>(std::move(*item)) : nullptr;
+    }
+
+    void wait_and_pop(T& data) {
+        data = wait_pop();
+    }
+
+    std::shared_ptr<T> wait_and_pop() {
+        return std::make_shared<T>(wait_pop());
+    }
+
+    bool empty() const {
+        return size() == 0;
+    }
+
+    int size() const {
+        // push counts its item only after unlocking the lane, so a pop of
+        // that item can be counted first.
+        return std::max(0, _size.load(std::memory_order_relaxed));
+    }
+
+    std::size_t lane_num() const { return _lane_num; }
+};
+}// ts
@@ -0,0 +1,310 @@
+#pragma once
+
+#include <iostream>
+
+#ifdef __linux__
+
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <new>
+#include <string>
+#include <system_error>
+#include <type_traits>
+
+#include <fcntl.h>
+#include <linux/futex.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace ts {
+namespace interprocess {
+
+// Bounded MPMC queue living in a named POSIX shared memory object, for
+// handing trivially copyable items between processes on one host.
+// Same sequence-numbered cells as lock_free::ring_queue. The region only
+// holds atomics, plain data and offsets, never pointers, so every process may
+// map it at a different address. Blocking push/pop sleep on process-shared
+// futexes, and the other side only issues a wake syscall when somebody sleeps.
+// A process dying in the middle of an operation can leave the queue stuck.
+template < class T >
+class ring_queue {
+private:
+    static_assert(std::is_trivially_copyable<T>::value,
+                  "interprocess::ring_queue requires a trivially copyable T");
+    static_assert(std::atomic<std::uint64_t>::is_always_lock_free &&
+                  std::atomic<std::uint32_t>::is_always_lock_free,
+                  "shared atomics have to be lock free to be address free");
+
+    static constexpr std::size_t _cache_line_size = 64;
+    static constexpr std::uint64_t _magic = 0x74735f73686d7131; // "ts_shmq1"
+
+    struct header {
+        std::atomic<std::uint64_t> _magic;
+        std::uint64_t _capacity;
+        std::uint64_t _item_size;
+        alignas(_cache_line_size) std::atomic<std::uint64_t> _enqueue_pos;
+        alignas(_cache_line_size) std::atomic<std::uint64_t> _dequeue_pos;
+        // Futex words, bumped whenever the queue stops being empty/full.
+        alignas(_cache_line_size) std::atomic<std::uint32_t> _not_empty;
+        std::atomic<std::uint32_t> _pop_waiters;
+        alignas(_cache_line_size) std::atomic<std::uint32_t> _not_full;
+        std::atomic<std::uint32_t> _push_waiters;
+    };
+
+    struct cell {
+        std::atomic<std::uint64_t> _sequence;
+        T _data;
+    };
+
+    static constexpr std::size_t cells_offset() {
+        return (sizeof(header) + alignof(cell) - 1) / alignof(cell) * alignof(cell);
+    }
+
+    static std::size_t region_size(std::size_t capacity) {
+        return cells_offset() + capacity * sizeof(cell);
+    }
+
+    static std::size_t round_up_capacity(std::size_t capacity) {
+        std::size_t size = 2;
+        while (size < capacity)
+            size <<= 1;
+        return size;
+    }
+
+    static void throw_errno(const char* what) {
+        throw std::system_error(errno, std::generic_category(), what);
+    }
+
+    static void futex_wait(std::atomic<std::uint32_t>& word, std::uint32_t expected) {
+        // Not FUTEX_PRIVATE_FLAG, the word is shared between processes.
+        ::syscall(SYS_futex, reinterpret_cast<std::uint32_t*>(&word), FUTEX_WAIT,
+                  expected, nullptr, nullptr, 0);
+    }
+
+    static void futex_wake(std::atomic<std::uint32_t>& word, int count) {
+        ::syscall(SYS_futex, reinterpret_cast<std::uint32_t*>(&word), FUTEX_WAKE,
+                  count, nullptr, nullptr, 0);
+    }
+
+    // Wake one sleeper on word, if there is any.
+    static void signal(std::atomic<std::uint32_t>& word, std::atomic<std::uint32_t>& waiters) {
+        // Pairs with the waiter registration in wait().
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (!waiters.load(std::memory_order_seq_cst))
+            return;
+        word.fetch_add(1, std::memory_order_seq_cst);
+        futex_wake(word, 1);
+    }
+
+    // Sleep on word until try_op() succeeds.
+    template < class Op >
+    static void wait(std::atomic<std::uint32_t>& word, std::atomic<std::uint32_t>& waiters, Op try_op) {
+        while (!try_op()) {
+            waiters.fetch_add(1, std::memory_order_seq_cst);
+            std::uint32_t seq = word.load(std::memory_order_seq_cst);
+            if (try_op()) {
+                waiters.fetch_sub(1, std::memory_order_relaxed);
+                return;
+            }
+            futex_wait(word, seq);
+            waiters.fetch_sub(1, std::memory_order_relaxed);
+        }
+    }
+
+private:
+    void* _region;
+    std::size_t _region_size;
+    // capacity - 1, validated once at create()/open(). Never re-read from
+    // the header, another process could have changed it since.
+    std::uint64_t _mask;
+
+    header& head() const { return *static_cast<header*>(_region); }
+    cell& cell_at(std::uint64_t pos) const {
+        auto cells = reinterpret_cast<cell*>(static_cast<char*>(_region) + cells_offset());
+        return cells[pos & _mask];
+    }
+
+    ring_queue(void* region, std::size_t size, std::uint64_t mask)
+        : _region(region), _region_size(size), _mask(mask) { }
+
+    static void* map(int fd, std::size_t size) {
+        void* region = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (region == MAP_FAILED) {
+            int err = errno;
+            ::close(fd);
+            errno = err;
+            throw_errno("mmap");
+        }
+        ::close(fd);
+        return region;
+    }
+
+public:
+    // Create a new shared memory object called name (e.g. "/my_queue"), fails
+    // if it already exists. capacity is rounded up to the next power of two.
+    static ring_queue create(const std::string& name, std::size_t capacity) {
+        capacity = round_up_capacity(capacity);
+        std::size_t size = region_size(capacity);
+        int fd = ::shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+        if (fd < 0)
+            throw_errno("shm_open");
+        if (::ftruncate(fd, size) < 0) {
+            int err = errno;
+            ::close(fd);
+            ::shm_unlink(name.c_str());
+            errno = err;
+            throw_errno("ftruncate");
+        }
+
+        ring_queue q(map(fd, size), size, capacity - 1);
+        header& h = *new (q._region) header;
+        h._capacity = capacity;
+        h._item_size = sizeof(T);
+        h._enqueue_pos.store(0, std::memory_order_relaxed);
+        h._dequeue_pos.store(0, std::memory_order_relaxed);
+        h._not_empty.store(0, std::memory_order_relaxed);
+        h._pop_waiters.store(0, std::memory_order_relaxed);
+        h._not_full.store(0, std::memory_order_relaxed);
+        h._push_waiters.store(0, std::memory_order_relaxed);
+        for (std::uint64_t i = 0; i < capacity; ++i) {
+            cell& c = *new (&q.cell_at(i)) cell;
+            c._sequence.store(i, std::memory_order_relaxed);
+        }
+        // Publish last, open() checks it.
+        h._magic.store(_magic, std::memory_order_release);
+        return q;
+    }
+
+    // Map a queue made by create(), possibly in another process.
+    static ring_queue open(const std::string& name) {
+        int fd = ::shm_open(name.c_str(), O_RDWR, 0);
+        if (fd < 0)
+            throw_errno("shm_open");
+        struct stat st;
+        if (::fstat(fd, &st) < 0) {
+            int err = errno;
+            ::close(fd);
+            errno = err;
+            throw_errno("fstat");
+        }
+        std::size_t size = static_cast<std::size_t>(st.st_size);
+        if (size < cells_offset()) {
+            ::close(fd);
+            throw std::system_error(std::make_error_code(std::errc::invalid_argument),
+                                    "shared memory object is not a ring_queue");
+        }
+
+        ring_queue q(map(fd, size), size, 0);
+        header& h = q.head();
+        // The rest of the header is only published once _magic is.
+        if (h._magic.load(std::memory_order_acquire) != _magic)
+            throw std::system_error(std::make_error_code(std::errc::invalid_argument),
+                                    "shared memory object is not a ring_queue");
+        // Do not trust the header further than the mapping: the cells must
+        // fit what was mapped.
+        std::uint64_t capacity = h._capacity;
+        if (h._item_size != sizeof(T) ||
+            capacity < 2 || (capacity & (capacity - 1)) ||
+            capacity > (size - cells_offset()) / sizeof(cell))
+            throw std::system_error(std::make_error_code(std::errc::invalid_argument),
+                                    "shared memory object is not a ring_queue of this type");
+        q._mask = capacity - 1;
+        return q;
+    }
+
+    // Remove the name, mappings stay valid until every process unmaps.
+    static void unlink(const std::string& name) {
+        ::shm_unlink(name.c_str());
+    }
+
+    ~ring_queue() {
+        if (_region)
+            ::munmap(_region, _region_size);
+    }
+    ring_queue(ring_queue&& other)
+        : _region(other._region), _region_size(other._region_size), _mask(other._mask) {
+        other._region = nullptr;
+    }
+    ring_queue(const ring_queue&) = delete;
+    ring_queue& operator=(const ring_queue&) = delete;
+
+    bool try_push(const T& data) {
+        header& h = head();
+        std::uint64_t pos = h._enqueue_pos.load(std::memory_order_relaxed);
+        while (true) {
+            cell& c = cell_at(pos);
+            std::uint64_t seq = c._sequence.load(std::memory_order_acquire);
+            auto diff = static_cast<std::int64_t>(seq - pos);
+            if (diff == 0) {
+                if (h._enqueue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                    break;
+            }
+            else if (diff < 0) {
+                return false; // full
+            }
+            else {
+                pos = h._enqueue_pos.load(std::memory_order_relaxed);
+            }
+        }
+        cell& c = cell_at(pos);
+        c._data = data;
+        c._sequence.store(pos + 1, std::memory_order_release);
+        signal(h._not_empty, h._pop_waiters);
+        return true;
+    }
+
+    // Sleep while the queue is full.
+    void push(const T& data) {
+        wait(head()._not_full, head()._push_waiters, [&] { return try_push(data); });
+    }
+
+    bool try_pop(T& data) {
+        header& h = head();
+        std::uint64_t pos = h._dequeue_pos.load(std::memory_order_relaxed);
+        while (true) {
+            cell& c = cell_at(pos);
+            std::uint64_t seq = c._sequence.load(std::memory_order_acquire);
+            auto diff = static_cast<std::int64_t>(seq - (pos + 1));
+            if (diff == 0) {
+                if (h._dequeue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                    break;
+            }
+            else if (diff < 0) {
+                return false; // empty
+            }
+            else {
+                pos = h._dequeue_pos.load(std::memory_order_relaxed);
+            }
+        }
+        cell& c = cell_at(pos);
+        data = c._data;
+        c._sequence.store(pos + _mask + 1, std::memory_order_release);
+        signal(h._not_full, h._push_waiters);
+        return true;
+    }
+
+    // Sleep while the queue is empty.
+    void wait_and_pop(T& data) {
+        wait(head()._not_empty, head()._pop_waiters, [&] { return try_pop(data); });
+    }
+
+    bool empty() const {
+        return size() == 0;
+    }
+
+    int size() const {
+        auto enqueue_pos = head()._enqueue_pos.load(std::memory_order_acquire);
+        auto dequeue_pos = head()._dequeue_pos.load(std::memory_order_acquire);
+        auto diff = static_cast<std::int64_t>(enqueue_pos - dequeue_pos);
+        return diff > 0 ? static_cast<int>(diff) : 0;
+    }
+
+    std::size_t capacity() const { return _mask + 1; }
+};
+}// interprocess
+}// ts
+
+#endif
@@ -0,0 +1,368 @@
+#pragma once
+
+#include <iostream>
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <iterator>
+#include <map>
+#include <memory>
+#include <new>
+#include <optional>
+#include <utility>
+
+#include "ts_backoff.hpp"
+#include "ts_reclaim.hpp"
+
+namespace ts {
+namespace lock_free {
+
+// Ordered map on a lock-free skiplist.
+// Every level is a Harris-style list: erase marks a node's next pointers top
+// down, the mark on level 0 decides who erased it, and searches unlink marked
+// nodes on their way. The inserter keeps linking upper levels after level 0
+// made the node visible, so a node is only retired once both the inserter and
+// the eraser are done with it. Values live behind an atomic pointer; nodes
+// and replaced values are reclaimed through epochs.
+// Lookups and iteration only read. Iterators hold a copy of the current item
+// and find the next one by key, so they neither pin memory nor block writers;
+// a scan sees every key present for its whole duration, in order.
+template < class Key, class Value, class Compare = std::less<Key> >
+class skiplist_map {
+private:
+    static constexpr int _max_height = 24;
+
+    struct node {
+        const Key _key;
+        std::atomic<Value*> _value;
+        const int _height;
+        // Dropped by the inserter and by the eraser, the last one retires.
+        std::atomic<int> _owners;
+
+        node(const Key& key, Value* value, int height)
+            : _key(key), _value(value), _height(height), _owners(2) { }
+        ~node() { delete _value.load(std::memory_order_relaxed); }
+
+        // The next pointers of all levels follow the node in memory.
+        std::atomic<node*>* next() { return reinterpret_cast<std::atomic<node*>*>(this + 1); }
+    };
+    static_assert(alignof(node) >= alignof(std::atomic<node*>), "next pointers would be misaligned");
+
+    static node* create_node(const Key& key, Value* value, int height) {
+        void* mem = ::operator new(sizeof(node) + height * sizeof(std::atomic<node*>));
+        node* n;
+        try {
+            n = new (mem) node(key, value, height);
+        }
+        catch (...) {
+            ::operator delete(mem);
+            throw;
+        }
+        for (int i = 0; i < height; ++i)
+            new (&n->next()[i]) std::atomic<node*>(nullptr);
+        return n;
+    }
+    static void destroy_node(node* n) {
+        n->~node();
+        ::operator delete(n);
+    }
+    static void release_node(node* n) {
+        if (n->_owners.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            epoch_domain::instance().retire(n, [](void* p) {
+                destroy_node(static_cast<node*>(p));
+            });
+        }
+    }
+
+    static bool is_marked(node* p) {
+        return reinterpret_cast<std::uintptr_t>(p) & 1;
+    }
+    static node* marked(node* p) {
+        return reinterpret_cast<node*>(reinterpret_cast<std::uintptr_t>(p) | 1);
+    }
+    static node* unmarked(node* p) {
+        return reinterpret_cast<node*>(reinterpret_cast<std::uintptr_t>(p) & ~std::uintptr_t(1));
+    }
+
+    static int random_height() {
+        std::uint32_t bits = thread_random();
+        int height = 1;
+        while ((bits & 1) && height < _max_height) {
+            ++height;
+            bits >>= 1;
+        }
+        return height;
+    }
+
+    std::atomic<node*> _head[_max_height];
+    std::atomic<int> _size;
+    Compare _compare;
+
+    // Fill preds/succs with the neighbours of key on every level, unlinking
+    // marked nodes on the way. preds[i] is the next pointer array of the
+    // predecessor on level i, succs[i] the first node not less than key.
+    // Returns whether succs[0] holds key. Must run inside an epoch guard.
+    bool find(const Key& key, std::atomic<node*>** preds, node** succs) {
+    retry:
+        std::atomic<node*>* pred = _head;
+        for (int level = _max_height - 1; level >= 0; --level) {
+            node* cur = pred[level].load();
+            // The predecessor got erased meanwhile.
+            if (is_marked(cur))
+                goto retry;
+            while (cur) {
+                node* succ = cur->next()[level].load();
+                if (is_marked(succ)) {
+                    node* expected = cur;
+                    if (!pred[level].compare_exchange_strong(expected, unmarked(succ)))
+                        goto retry;
+                    cur = unmarked(succ);
+                    continue;
+                }
+                if (!_compare(cur->_key, key))
+                    break;
+                pred = cur->next();
+                cur = succ;
+            }
+            preds[level] = pred;
+            succs[level] = cur;
+        }
+        return succs[0] && !_compare(key, succs[0]->_key);
+    }
+
+    // Link levels 1.. of a node already linked on level 0. Gives up once the
+    // node gets erased.
+    void link_upper_levels(node* n, std::atomic<node*>** preds, node** succs) {
+        for (int level = 1; level < n->_height; ++level) {
+            while (true) {
+                node* next = n->next()[level].load();
+                if (is_marked(next))
+                    return;
+                if (next != succs[level] && !n->next()[level].compare_exchange_strong(next, succs[level]))
+                    return; // only an eraser changes it under us
+                node* expected = succs[level];
+                if (preds[level][level].compare_exchange_strong(expected, n))
+                    break;
+                if (!find(n->_key, preds, succs) || succs[0] != n)
+                    return;
+            }
+        }
+    }
+
+    // First node whose key is not less than key (or greater than key if
+    // strict), skipping erased ones. Read only, must run inside an epoch guard.
+    node* seek(const Key& key, bool strict) const {
+        const std::atomic<node*>* pred = _head;
+        node* cur = nullptr;
+        for (int level = _max_height - 1; level >= 0; --level) {
+            cur = unmarked(pred[level].load(std::memory_order_acquire));
+            while (cur && (strict ? !_compare(key, cur->_key) : _compare(cur->_key, key))) {
+                pred = cur->next();
+                cur = unmarked(cur->next()[level].load(std::memory_order_acquire));
+            }
+        }
+        while (cur && is_marked(cur->next()[0].load(std::memory_order_acquire)))
+            cur = unmarked(cur->next()[0].load(std::memory_order_acquire));
+        return cur;
+    }
+
+    node* first_node() const {
+        node* cur = unmarked(_head[0].load(std::memory_order_acquire));
+        while (cur && is_marked(cur->next()[0].load(std::memory_order_acquire)))
+            cur = unmarked(cur->next()[0].load(std::memory_order_acquire));
+        return cur;
+    }
+
+public:
+    class const_iterator {
+    public:
+        typedef std::forward_iterator_tag iterator_category;
+        typedef std::pair<Key, Value> value_type;
+        typedef std::ptrdiff_t difference_type;
+        typedef const value_type* pointer;
+        typedef const value_type& reference;
+
+    private:
+        friend class skiplist_map;
+
+        const skiplist_map* _map;
+        std::optional<value_type> _item;
+
+        // n must be protected by the caller's epoch guard.
+        const_iterator(const skiplist_map* map, node* n): _map(map) {
+            if (n)
+                _item.emplace(n->_key, *n->_value.load(std::memory_order_acquire));
+        }
+
+    public:
+        const_iterator(): _map(nullptr) { }
+
+        reference operator*() const { return *_item; }
+        pointer operator->() const { return &*_item; }
+
+        const_iterator& operator++() {
+            *this = _map->upper_bound(_item->first);
+            return *this;
+        }
+        const_iterator operator++(int) {
+            const_iterator old = *this;
+            ++*this;
+            return old;
+        }
+
+        bool operator==(const const_iterator& other) const {
+            if (!_item || !other._item)
+                return !_item && !other._item;
+            return !_map->_compare(_item->first, other._item->first) &&
+                   !_map->_compare(other._item->first, _item->first);
+        }
+        bool operator!=(const const_iterator& other) const { return !(*this == other); }
+    };
+
+    explicit skiplist_map(const Compare& compare = Compare())
+        : _size(0), _compare(compare) {
+        for (auto& head : _head)
+            head.store(nullptr, std::memory_order_relaxed);
+    }
+    // Make sure no thread now is accessing current map instance
+    ~skiplist_map() {
+        node* cur = _head[0].load();
+        while (cur) {
+            node* next = unmarked(cur->next()[0].load());
+            destroy_node(cur);
+            cur = next;
+        }
+    }
+    skiplist_map(const skiplist_map&) = delete;
+    skiplist_map& operator=(const skiplist_map&) = delete;
+
+    // Returns false if key was present, its value is replaced then.
+    bool insert(const Key& key, const Value& value) {
+        // Owned here until a node or the existing entry takes it over.
+        std::unique_ptr<Value> new_value(new Value(value));
+        node* n = nullptr;
+        reclaim::epoch::guard guard;
+        std::atomic<node*>* preds[_max_height];
+        node* succs[_max_height];
+
+        while (true) {
+            if (find(key, preds, succs)) {
+                if (n) {
+                    new_value.reset(n->_value.exchange(nullptr, std::memory_order_relaxed));
+                    destroy_node(n);
+                }
+                Value* old = succs[0]->_value.exchange(new_value.release(), std::memory_order_acq_rel);
+                reclaim::epoch::retire(old);
+                return false;
+            }
+            if (!n) {
+                n = create_node(key, new_value.get(), random_height());
+                new_value.release();
+            }
+            for (int level = 0; level < n->_height; ++level)
+                n->next()[level].store(succs[level], std::memory_order_relaxed);
+            node* expected = succs[0];
+            if (preds[0][0].compare_exchange_strong(expected, n))
+                break;
+        }
+
+        _size.fetch_add(1, std::memory_order_relaxed);
+        link_upper_levels(n, preds, succs);
+        // Erased while linking, make sure no level still points to it.
+        if (is_marked(n->next()[0].load()))
+            find(key, preds, succs);
+        release_node(n);
+        return true;
+    }
+
+    // Returns false if key was not present.
+    bool erase(const Key& key) {
+        reclaim::epoch::guard guard;
+        std::atomic<node*>* preds[_max_height];
+        node* succs[_max_height];
+        if (!find(key, preds, succs))
+            return false;
+
+        node* n = succs[0];
+        for (int level = n->_height - 1; level > 0; --level) {
+            node* next = n->next()[level].load();
+            while (!is_marked(next) && !n->next()[level].compare_exchange_weak(next, marked(next)));
+        }
+        node* next = n->next()[0].load();
+        while (true) {
+            if (is_marked(next))
+                return false; // somebody else erased it first
+            if (n->next()[0].compare_exchange_weak(next, marked(next)))
+                break;
+        }
+
+        _size.fetch_sub(1, std::memory_order_relaxed);
+        find(key, preds, succs);
+        release_node(n);
+        return true;
+    }
+
+    bool find(const Key& key) const {
+        reclaim::epoch::guard guard;
+        node* n = seek(key, false);
+        return n && !_compare(key, n->_key);
+    }
+
+    // Copies the value into value, returns false if key is not present.
+    bool get(const Key& key, Value& value) const {
+        reclaim::epoch::guard guard;
+        node* n = seek(key, false);
+        if (!n || _compare(key, n->_key))
+            return false;
+        value = *n->_value.load(std::memory_order_acquire);
+        return true;
+    }
+
+    Value get(const Key& key) const {
+        Value value = Value();
+        get(key, value);
+        return value;
+    }
+
+    // First item whose key is not less than key.
+    const_iterator lower_bound(const Key& key) const {
+        reclaim::epoch::guard guard;
+        return const_iterator(this, seek(key, false));
+    }
+
+    // First item whose key is greater than key.
+    const_iterator upper_bound(const Key& key) const {
+        reclaim::epoch::guard guard;
+        return const_iterator(this, seek(key, true));
+    }
+
+    const_iterator begin() const {
+        reclaim::epoch::guard guard;
+        return const_iterator(this, first_node());
+    }
+
+    const_iterator end() const { return const_iterator(); }
+
+    int size() const {
+        return std::max(0, _size.load(std::memory_order_relaxed));
+    }
+
+    bool empty() const {
+        return size() == 0;
+    }
+
+    void clear() {
+        for (auto it = begin(); it != end(); ++it)
+            erase(it->first);
+    }
+
+    std::map<Key, Value, Compare> get_map() const {
+        std::map<Key, Value, Compare> map(_compare);
+        for (auto it = begin(); it != end(); ++it)
+            map.insert(map.end(), *it);
+        return map;
+    }
+};
+}// lock_free
+}// ts
@@ -0,0 +1,194 @@
+#pragma once
+
+#include <iostream>
+#include <atomic>
+#include <algorithm>
+#include <memory>
+#include <new>
+#include <thread>
+#include <type_traits>
+
+namespace ts {
+
+// Bounded queue for exactly one producer thread and one consumer thread.
+// Each side owns its index and keeps a cached copy of the other side's index,
+// so the fast path is a plain load/store pair with no atomic RMW, and the
+// shared cache line is only read when the cached view says full/empty.
+template < class T >
+class spsc_queue {
+private:
+    static constexpr std::size_t _cache_line_size = 64;
+    typedef typename std::aligned_storage<sizeof(T), alignof(T)>::type storage;
+
+    static std::size_t round_up_capacity(std::size_t capacity) {
+        std::size_t size = 2;
+        while (size < capacity)
+            size <<= 1;
+        return size;
+    }
+
+private:
+    const std::size_t _mask;
+    std::unique_ptr<storage[]> _slots;
+
+    // Producer side
+    alignas(_cache_line_size) std::atomic<std::size_t> _tail;
+    std::size_t _head_cache;
+    // Consumer side
+    alignas(_cache_line_size) std::atomic<std::size_t> _head;
+    std::size_t _tail_cache;
+
+    T* slot(std::size_t index) {
+        return std::launder(reinterpret_cast<T*>(&_slots[index & _mask]));
+    }
+
+    // Number of free slots seen by the producer, refreshing the cached head
+    // only when the cached view is not enough.
+    std::size_t writable(std::size_t tail, std::size_t wanted) {
+        std::size_t free = capacity() - (tail - _head_cache);
+        if (free < wanted) {
+            _head_cache = _head.load(std::memory_order_acquire);
+            free = capacity() - (tail - _head_cache);
+        }
+        return free;
+    }
+
+    std::size_t readable(std::size_t head, std::size_t wanted) {
+        std::size_t available = _tail_cache - head;
+        if (available < wanted) {
+            _tail_cache = _tail.load(std::memory_order_acquire);
+            available = _tail_cache - head;
+        }
+        return available;
+    }
+
+public:
+    // capacity is rounded up to the next power of two.
+    explicit spsc_queue(std::size_t capacity = 1024)
+        : _mask(round_up_capacity(capacity) - 1),
+          _slots(new storage[_mask + 1]),
+          _tail(0), _head_cache(0),
+          _head(0), _tail_cache(0) { }
+    // Make sure neither the producer nor the consumer is still running
+    ~spsc_queue() {
+        std::size_t head = _head.load(std::memory_order_relaxed);
+        std::size_t tail = _tail.load(std::memory_order_relaxed);
+        for (; head != tail; ++head)
+            slot(head)->~T();
+    }
+    spsc_queue(const spsc_queue&) = delete;
+    spsc_queue& operator=(const spsc_queue&) = delete;
+
+    // Producer only
+    template < class... Args >
+    bool try_emplace(Args&&... args) {
+        std::size_t tail = _tail.load(std::memory_order_relaxed);
+        if (!writable(tail, 1))
+            return false;
+        new (slot(tail)) T(std::forward<Args>(args)...);
+        _tail.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool try_push(T data) {
+        return try_emplace(std::move(data));
+    }
+
+    // Spin (yielding) while the queue is full.
+    void push(T data) {
+        while (!try_emplace(std::move(data)))
+            std::this_thread::yield();
+    }
+
+    // Push up to n items from first, publishing them with a single store.
+    // Returns the number of items pushed. If constructing an item throws,
+    // none of the batch is pushed.
+    template < class InputIt >
+    std::size_t push_n(InputIt first, std::size_t n) {
+        std::size_t tail = _tail.load(std::memory_order_relaxed);
+        std::size_t count = std::min(n, writable(tail, n));
+        std::size_t i = 0;
+        try {
+            for (; i < count; ++i, ++first)
+                new (slot(tail + i)) T(*first);
+        }
+        catch (...) {
+            while (i)
+                slot(tail + --i)->~T();
+            throw;
+        }
+        _tail.store(tail + count, std::memory_order_release);
+        return count;
+    }
+
+    // Consumer only
+    bool try_pop(T& data) {
+        std::size_t head = _head.load(std::memory_order_relaxed);
+        if (!readable(head, 1))
+            return false;
+        T* item = slot(head);
+        data = std::move(*item);
+        item->~T();
+        _head.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    std::shared_ptr<T> try_pop() {
+        std::size_t head = _head.load(std::memory_order_relaxed);
+        if (!readable(head, 1))
+            return nullptr;
+        T* item = slot(head);
+        auto data = std::make_shared<T>(std::move(*item));
+        item->~T();
+        _head.store(head + 1, std::memory_order_release);
+        return data;
+    }
+
+    void wait_and_pop(T& data) {
+        while (!try_pop(data))
+            std::this_thread::yield();
+    }
+
+    std::shared_ptr<T> wait_and_pop() {
+        std::shared_ptr<T> data;
+        while (!(data = try_pop()))
+            std::this_thread::yield();
+        return data;
+    }
+
+    // Move up to max items into out, releasing the slots with a single store.
+    // Returns the number of items popped. If writing to out throws, the items
+    // already written are popped and the rest stay queued.
+    template < class OutputIt >
+    std::size_t pop_n(OutputIt out, std::size_t max) {
+        std::size_t head = _head.load(std::memory_order_relaxed);
+        std::size_t count = std::min(max, readable(head, max));
+        std::size_t i = 0;
+        try {
+            for (; i < count; ++i) {
+                T* item = slot(head + i);
+                *out++ = std::move(*item);
+                item->~T();
+            }
+        }
+        catch (...) {
+            _head.store(head + i, std::memory_order_release);
+            throw;
+        }
+        _head.store(head + count, std::memory_order_release);
+        return count;
+    }
+
+    bool empty() const {
+        return size() == 0;
+    }
+
+    int size() const {
+        std::size_t head = _head.load(std::memory_order_acquire);
+        std::size_t tail = _tail.load(std::memory_order_acquire);
+        return static_cast<int>(tail - head);
+    }
+
+    std::size_t capacity() const { return _mask + 1; }
+};
+}// ts
@@ -5,6 +5,15 @@
 #include <mutex>
 #include <memory>
 #include <atomic>
+#include <vector>
+#include <algorithm>
+#include <optional>
+#include <new>
+
+#include "ts_reclaim.hpp"
+#include "ts_counted_ptr.hpp"
+#include "ts_node_pool.hpp"
+#include "ts_backoff.hpp"
 
 namespace ts {
 
@@ -44,6 +53,26 @@ public:
         return value;
     }
 
+    // Swap the whole content out under one lock. Items come back top first,
+    // or in push order when fifo is set.
+    inline std::vector<T> pop_all(bool fifo = false) {
+        std::stack<T> data;
+        {
+            std::lock_guard<std::mutex> lk(this->_m);
+            _data.swap(data);
+        }
+
+        std::vector<T> items;
+        items.reserve(data.size());
+        while (!data.empty()) {
+            items.push_back(std::move(data.top()));
+            data.pop();
+        }
+        if (fifo)
+            std::reverse(items.begin(), items.end());
+        return items;
+    }
+
     inline bool empty() const {
         std::lock_guard<std::mutex> lk(this->_m);
         return _data.empty();
@@ -60,14 +89,16 @@ private:
 };
 
 namespace lock_free {
+
+// Reclaimer selects how popped nodes are freed, see ts_reclaim.hpp.
+template < class T, class Reclaimer = reclaim::ref_count >
+class stack;
+
 template < class T >
-class stack {
+class stack<T, reclaim::ref_count> {
 private:
     struct node;
-    struct counted_node {
-        int external_count;
-        node* ptr;
-    };
+    typedef counted_ptr<node> counted_node;
     struct node {
         std::shared_ptr<T> _data;
         std::atomic<int> _internal_count;
@@ -95,11 +126,12 @@ public:
     }
 private:
     std::atomic<counted_node> _head;
+#ifndef TS_WIDE_COUNTED_PTR
+    static_assert(std::atomic<counted_node>::is_always_lock_free,
+                  "the packed counted head must not fall back to libatomic locks");
+#endif
 public:
-    stack() {
-        counted_node n = { 0, nullptr };
-        _head.store(n);
-    }
+    stack(): _head(counted_node()) { }
     // Make sure no thread now is accessing current stack instance
     ~stack() { 
         while (pop()) {}
@@ -107,22 +139,15 @@ public:
 public:
     void push(const T& data) {
         node* item = new node(data);
-        counted_node n = { 1, item };
+        counted_node n(item, 1);
         item->_next = _head.load();
         while (!_head.compare_exchange_weak(item->_next, n, 
             std::memory_order_release/*, std::memory_order_relaxed*/));
     }
 
     void increase_external_count(counted_node& old_head) {
-
-        counted_node new_node;
-        do {
-            new_node = old_head;
-            ++new_node.external_count;
-        } while (!_head.compare_exchange_strong(old_head, new_node, 
-                                                std::memory_order_acquire, 
-                                                std::memory_order_relaxed));
-        old_head.external_count= new_node.external_count;
+        ts::increase_external_count(_head, old_head, std::memory_order_acquire,
+                                    std::memory_order_relaxed);
     }
 
     std::shared_ptr<T> pop() {
@@ -130,8 +155,11 @@ public:
         counted_node old_head = _head.load(std::memory_order_relaxed);
 
         while (true) {
+            // Do not pin an empty head, polling would run its count up.
+            if (!old_head.ptr())
+                return std::shared_ptr<T>();
             increase_external_count(old_head);
-            node* ptr = old_head.ptr;
+            node* ptr = old_head.ptr();
             if (!ptr)
                 return std::shared_ptr<T>();
 
@@ -141,7 +169,7 @@ public:
                 std::shared_ptr<T> res;
                 res.swap(ptr->_data);
 
-                int increase_count = old_head.external_count - 2;
+                int increase_count = static_cast<int>(old_head.count()) - 2;
                 if (ptr->_internal_count.fetch_add(increase_count, 
                                                    std::memory_order_release) == -increase_count) {
                     delete ptr;
@@ -156,11 +184,474 @@ public:
 
         return std::shared_ptr<T>();
     }
+
+    // Detach the whole chain with a single exchange. Items come back top
+    // first, or in push order when fifo is set.
+    std::vector<std::shared_ptr<T>> pop_all(bool fifo = false) {
+
+        std::vector<std::shared_ptr<T>> items;
+        counted_node cur = _head.exchange(counted_node(), std::memory_order_acquire);
+
+        // Pops that lost the race may still hold a node through the external
+        // count of the pointer that referenced it (_head or the previous
+        // node's _next), so fold that count in as a successful pop does,
+        // minus the increment this thread never made.
+        while (node* ptr = cur.ptr()) {
+            counted_node next = ptr->_next;
+            items.emplace_back();
+            items.back().swap(ptr->_data);
+
+            int increase_count = static_cast<int>(cur.count()) - 1;
+            if (ptr->_internal_count.fetch_add(increase_count,
+                                               std::memory_order_release) == -increase_count) {
+                delete ptr;
+            }
+            cur = next;
+        }
+
+        if (fifo)
+            std::reverse(items.begin(), items.end());
+        return items;
+    }
+};
+
+template < class T >
+std::atomic<int> stack<T, reclaim::ref_count>::node::_allocated_num = 0;
+template < class T >
+std::atomic<int> stack<T, reclaim::ref_count>::node::_deallocated_num = 0;
+
+// Treiber stack whose popped nodes are handed to a guard based Reclaimer
+// (e.g. reclaim::hazard_pointer), so _head is a single machine word and pop
+// does not have to bump a count on the head node.
+template < class T, class Reclaimer >
+class stack {
+private:
+    struct node {
+        std::shared_ptr<T> _data;
+        node* _next;
+        node (const T& data): _data(std::make_shared<T>(data)), _next(nullptr) { }
+    };
+
+    std::atomic<node*> _head;
+
+public:
+    stack(): _head(nullptr) { }
+    // Make sure no thread now is accessing current stack instance
+    ~stack() {
+        node* cur = _head.load();
+        while (cur) {
+            node* next = cur->_next;
+            delete cur;
+            cur = next;
+        }
+    }
+    stack(const stack&) = delete;
+    stack& operator=(const stack&) = delete;
+
+    void push(const T& data) {
+        node* item = new node(data);
+        item->_next = _head.load(std::memory_order_relaxed);
+        while (!_head.compare_exchange_weak(item->_next, item,
+                                            std::memory_order_release,
+                                            std::memory_order_relaxed));
+    }
+
+    std::shared_ptr<T> pop() {
+        typename Reclaimer::guard guard;
+        node* old_head;
+        do {
+            old_head = guard.protect(_head);
+            if (!old_head)
+                return std::shared_ptr<T>();
+        } while (!_head.compare_exchange_strong(old_head, old_head->_next));
+        guard.reset();
+
+        std::shared_ptr<T> res;
+        res.swap(old_head->_data);
+        Reclaimer::retire(old_head);
+        return res;
+    }
+
+    // Detach the whole chain with a single exchange. Items come back top
+    // first, or in push order when fifo is set. Nodes are still retired, as
+    // concurrent pops may be reading the _next of any former head.
+    std::vector<std::shared_ptr<T>> pop_all(bool fifo = false) {
+        std::vector<std::shared_ptr<T>> items;
+        node* cur = _head.exchange(nullptr, std::memory_order_acquire);
+        while (cur) {
+            node* next = cur->_next;
+            items.emplace_back();
+            items.back().swap(cur->_data);
+            Reclaimer::retire(cur);
+            cur = next;
+        }
+
+        if (fifo)
+            std::reverse(items.begin(), items.end());
+        return items;
+    }
+
+    bool empty() const {
+        return _head.load() == nullptr;
+    }
 };
 
+// Treiber stack that stores T inline in nodes taken from node_pool, so push
+// and pop do not allocate once the pool is warm, and pop moves the value out
+// instead of sharing it through a shared_ptr.
+// A pop publishes the head node in a hazard pointer before reading its _next,
+// and popped nodes only go back to the pool once no hazard points to them.
+// So the node a pop CASes on cannot be recycled and pushed again under it
+// (no ABA), and a node being re-initialized for a push is never read. The
+// head's 16-bit count alone would not do: it wraps after 65,536 updates and
+// the per-thread pool caches hand the same address back right away.
 template < class T >
-std::atomic<int> stack<T>::node::_allocated_num = 0;
+class pooled_stack {
+private:
+    struct node {
+        typename std::aligned_storage<sizeof(T), alignof(T)>::type _storage;
+        // Left uninitialized, push_node() stores it before publishing.
+        std::atomic<node*> _next;
+        T* data() { return std::launder(reinterpret_cast<T*>(&_storage)); }
+    };
+    typedef node_pool<node> pool;
+    typedef counted_ptr<node> counted_node;
+
+    std::atomic<counted_node> _head;
+#ifndef TS_WIDE_COUNTED_PTR
+    static_assert(std::atomic<counted_node>::is_always_lock_free,
+                  "the packed counted head must not fall back to libatomic locks");
+#endif
+
+    void push_node(node* item) {
+        counted_node old_head = _head.load(std::memory_order_relaxed);
+        do {
+            item->_next.store(old_head.ptr(), std::memory_order_relaxed);
+        } while (!_head.compare_exchange_weak(old_head,
+                                              counted_node(item, old_head.count() + 1),
+                                              std::memory_order_release,
+                                              std::memory_order_relaxed));
+    }
+
+    node* pop_node() {
+        hazard_pointer hp;
+        counted_node old_head = _head.load(std::memory_order_acquire);
+        while (node* ptr = old_head.ptr()) {
+            hp.publish(ptr);
+            counted_node current = _head.load(std::memory_order_seq_cst);
+            if (current.ptr() != ptr) {
+                old_head = current;
+                continue;
+            }
+            node* next = ptr->_next.load(std::memory_order_relaxed);
+            if (_head.compare_exchange_weak(current,
+                                            counted_node(next, current.count() + 1),
+                                            std::memory_order_acquire,
+                                            std::memory_order_acquire))
+                return ptr;
+            old_head = current;
+        }
+        return nullptr;
+    }
+
+    // The value goes now, the node once no racing pop may still read it.
+    static void delete_node(node* item) {
+        item->data()->~T();
+        hazard_pointer_domain::instance().retire(item, [](void* p) {
+            static_cast<node*>(p)->~node();
+            pool::deallocate(p);
+        });
+    }
+
+public:
+    pooled_stack(): _head(counted_node()) { }
+    // Make sure no thread now is accessing current stack instance
+    ~pooled_stack() {
+        while (node* item = pop_node())
+            delete_node(item);
+    }
+    pooled_stack(const pooled_stack&) = delete;
+    pooled_stack& operator=(const pooled_stack&) = delete;
+
+    template < class... Args >
+    void emplace(Args&&... args) {
+        node* item = new (pool::allocate()) node;
+        try {
+            new (&item->_storage) T(std::forward<Args>(args)...);
+        }
+        catch (...) {
+            item->~node();
+            pool::deallocate(item);
+            throw;
+        }
+        push_node(item);
+    }
+
+    void push(const T& data) { emplace(data); }
+    void push(T&& data) { emplace(std::move(data)); }
+
+    bool pop(T& data) {
+        node* item = pop_node();
+        if (!item)
+            return false;
+        data = std::move(*item->data());
+        delete_node(item);
+        return true;
+    }
+
+    std::optional<T> pop() {
+        node* item = pop_node();
+        if (!item)
+            return std::nullopt;
+        std::optional<T> data(std::move(*item->data()));
+        delete_node(item);
+        return data;
+    }
+
+    // Detach the whole chain with a single CAS. Items come back top first,
+    // or in push order when fifo is set.
+    std::vector<T> pop_all(bool fifo = false) {
+        counted_node old_head = _head.load(std::memory_order_relaxed);
+        while (!_head.compare_exchange_weak(old_head,
+                                            counted_node(nullptr, old_head.count() + 1),
+                                            std::memory_order_acquire,
+                                            std::memory_order_relaxed));
+
+        std::vector<T> items;
+        node* cur = old_head.ptr();
+        while (cur) {
+            node* next = cur->_next.load(std::memory_order_relaxed);
+            items.push_back(std::move(*cur->data()));
+            delete_node(cur);
+            cur = next;
+        }
+
+        if (fifo)
+            std::reverse(items.begin(), items.end());
+        return items;
+    }
+
+    bool empty() const {
+        return _head.load().ptr() == nullptr;
+    }
+
+    // Nodes ever requested from the global allocator by all pooled_stack<T>.
+    static std::size_t allocated_node_num() {
+        return pool::allocated_num();
+    }
+};
+
+// pooled_stack with an elimination array in front of the head.
+// When the head CAS fails, a push parks its node in a random slot for a short
+// while and a pop takes a parked node from a random slot, so colliding
+// push/pop pairs exchange the value without touching _head. The range of
+// slots in use grows on successful exchanges and shrinks on timeouts.
 template < class T >
-std::atomic<int> stack<T>::node::_deallocated_num = 0;
+class elimination_stack {
+private:
+    struct node {
+        typename std::aligned_storage<sizeof(T), alignof(T)>::type _storage;
+        // Left uninitialized, try_push_node() stores it before publishing.
+        std::atomic<node*> _next;
+        T* data() { return std::launder(reinterpret_cast<T*>(&_storage)); }
+    };
+    typedef node_pool<node> pool;
+    // The count is a version, so a push withdrawing its node can tell it was
+    // taken even if the same node came back to the slot in the meantime.
+    typedef counted_ptr<node> counted_node;
+
+    static constexpr std::size_t _cache_line_size = 64;
+    static constexpr int _slot_num = 16;
+    static constexpr int _wait_spins = 256;
+
+    struct alignas(_cache_line_size) slot {
+        std::atomic<counted_node> _item;
+        slot(): _item(counted_node()) { }
+    };
+
+    alignas(_cache_line_size) std::atomic<counted_node> _head;
+    alignas(_cache_line_size) std::atomic<int> _range;
+    slot _slots[_slot_num];
+
+    bool try_push_node(node* item) {
+        counted_node old_head = _head.load(std::memory_order_relaxed);
+        item->_next.store(old_head.ptr(), std::memory_order_relaxed);
+        return _head.compare_exchange_strong(old_head,
+                                             counted_node(item, old_head.count() + 1),
+                                             std::memory_order_release,
+                                             std::memory_order_relaxed);
+    }
+
+    // Returns false on contention, true with item == nullptr when empty.
+    // Same hazard pointer protection as pooled_stack::pop_node().
+    bool try_pop_node(hazard_pointer& hp, node*& item) {
+        counted_node old_head = _head.load(std::memory_order_acquire);
+        item = old_head.ptr();
+        if (!item)
+            return true;
+        hp.publish(item);
+        if (_head.load(std::memory_order_seq_cst).ptr() != item)
+            return false;
+        node* next = item->_next.load(std::memory_order_relaxed);
+        return _head.compare_exchange_strong(old_head,
+                                             counted_node(next, old_head.count() + 1),
+                                             std::memory_order_acquire,
+                                             std::memory_order_relaxed);
+    }
+
+    slot& random_slot() {
+        return _slots[thread_random() % _range.load(std::memory_order_relaxed)];
+    }
+
+    void grow_range() {
+        int range = _range.load(std::memory_order_relaxed);
+        if (range < _slot_num)
+            _range.compare_exchange_weak(range, range + 1, std::memory_order_relaxed);
+    }
+
+    void shrink_range() {
+        int range = _range.load(std::memory_order_relaxed);
+        if (range > 1)
+            _range.compare_exchange_weak(range, range - 1, std::memory_order_relaxed);
+    }
+
+    // Park item in a slot and wait for a pop to take it.
+    bool try_eliminate_push(node* item) {
+        auto& s = random_slot();
+        counted_node empty = s._item.load(std::memory_order_relaxed);
+        if (empty.ptr())
+            return false;
+        counted_node parked(item, empty.count() + 1);
+        if (!s._item.compare_exchange_strong(empty, parked, std::memory_order_release,
+                                             std::memory_order_relaxed))
+            return false;
+
+        for (int i = 0; i < _wait_spins; ++i) {
+            if (s._item.load(std::memory_order_relaxed).ptr() != item) {
+                grow_range();
+                return true;
+            }
+            cpu_relax();
+        }
+
+        if (s._item.compare_exchange_strong(parked, counted_node(nullptr, parked.count() + 1),
+                                            std::memory_order_relaxed)) {
+            shrink_range();
+            return false;
+        }
+        // Taken while withdrawing.
+        grow_range();
+        return true;
+    }
+
+    node* try_eliminate_pop() {
+        auto& s = random_slot();
+        counted_node parked = s._item.load(std::memory_order_acquire);
+        if (!parked.ptr())
+            return nullptr;
+        if (s._item.compare_exchange_strong(parked, counted_node(nullptr, parked.count() + 1),
+                                            std::memory_order_acquire,
+                                            std::memory_order_relaxed))
+            return parked.ptr();
+        return nullptr;
+    }
+
+    void push_node(node* item) {
+        while (!try_push_node(item)) {
+            if (try_eliminate_push(item))
+                return;
+        }
+    }
+
+    node* pop_node() {
+        hazard_pointer hp;
+        node* item;
+        while (!try_pop_node(hp, item)) {
+            if (node* eliminated = try_eliminate_pop())
+                return eliminated;
+        }
+        return item;
+    }
+
+    static void delete_node(node* item) {
+        item->data()->~T();
+        hazard_pointer_domain::instance().retire(item, [](void* p) {
+            static_cast<node*>(p)->~node();
+            pool::deallocate(p);
+        });
+    }
+
+public:
+    elimination_stack(): _head(counted_node()), _range(1) { }
+    // Make sure no thread now is accessing current stack instance
+    ~elimination_stack() {
+        while (node* item = pop_node())
+            delete_node(item);
+    }
+    elimination_stack(const elimination_stack&) = delete;
+    elimination_stack& operator=(const elimination_stack&) = delete;
+
+    template < class... Args >
+    void emplace(Args&&... args) {
+        node* item = new (pool::allocate()) node;
+        try {
+            new (&item->_storage) T(std::forward<Args>(args)...);
+        }
+        catch (...) {
+            item->~node();
+            pool::deallocate(item);
+            throw;
+        }
+        push_node(item);
+    }
+
+    void push(const T& data) { emplace(data); }
+    void push(T&& data) { emplace(std::move(data)); }
+
+    bool pop(T& data) {
+        node* item = pop_node();
+        if (!item)
+            return false;
+        data = std::move(*item->data());
+        delete_node(item);
+        return true;
+    }
+
+    std::optional<T> pop() {
+        node* item = pop_node();
+        if (!item)
+            return std::nullopt;
+        std::optional<T> data(std::move(*item->data()));
+        delete_node(item);
+        return data;
+    }
+
+    // Detach the whole chain with a single CAS. Items come back top first,
+    // or in push order when fifo is set.
+    std::vector<T> pop_all(bool fifo = false) {
+        counted_node old_head = _head.load(std::memory_order_relaxed);
+        while (!_head.compare_exchange_weak(old_head,
+                                            counted_node(nullptr, old_head.count() + 1),
+                                            std::memory_order_acquire,
+                                            std::memory_order_relaxed));
+
+        std::vector<T> items;
+        node* cur = old_head.ptr();
+        while (cur) {
+            node* next = cur->_next.load(std::memory_order_relaxed);
+            items.push_back(std::move(*cur->data()));
+            delete_node(cur);
+            cur = next;
+        }
+
+        if (fifo)
+            std::reverse(items.begin(), items.end());
+        return items;
+    }
+
+    bool empty() const {
+        return _head.load().ptr() == nullptr;
+    }
+};
 }// lock_free
 }// ts
@@ -0,0 +1,108 @@
+#pragma once
+
+#include <iostream>
+#include <atomic>
+#include <vector>
+
+#include "ts_reclaim.hpp"
+
+namespace ts {
+
+// Bucket tables of a hash map that grows online.
+// Growing only publishes a bigger table that points back to the old one;
+// buckets then move over one at a time, either when an operation touches
+// them or in small steps taken by every writer. How a bucket moves and how
+// it is locked is up to the map, the chain only tracks the tables and
+// retires the old one once its last bucket has moved.
+// Everything except the constructor and destructor must run inside an
+// epoch guard.
+template < class Bucket >
+class table_chain {
+public:
+    // While growing, _next of the old table points to the new one and _old of
+    // the new one back to the old one, until every old bucket has moved.
+    struct table {
+        std::vector<Bucket> _buckets;
+        std::atomic<table*> _old;
+        std::atomic<table*> _next;
+        std::atomic<std::size_t> _migrate_pos;
+        std::atomic<std::size_t> _moved_num;
+
+        table(std::size_t bucket_size, table* old)
+            : _buckets(bucket_size), _old(old), _next(nullptr), _migrate_pos(0), _moved_num(0) { }
+
+        Bucket& get_bucket(std::size_t hash) {
+            return _buckets[hash % _buckets.size()];
+        }
+    };
+
+private:
+    // Buckets every writer moves on the side while a migration runs.
+    static const int _migrate_step = 2;
+    static const int _max_load_factor = 2;
+    std::atomic<table*> _table;
+
+public:
+    explicit table_chain(std::size_t bucket_size)
+        : _table(new table(bucket_size, nullptr)) { }
+    // Make sure no thread now is accessing the owning map
+    ~table_chain() {
+        table* t = _table.load();
+        delete t->_old.load();
+        delete t;
+    }
+    table_chain(const table_chain&) = delete;
+    table_chain& operator=(const table_chain&) = delete;
+
+    table* newest() const {
+        return _table.load(std::memory_order_acquire);
+    }
+
+    // The oldest table still holding items.
+    table* first() const {
+        table* t = newest();
+        table* old = t->_old.load(std::memory_order_acquire);
+        return old ? old : t;
+    }
+
+    // Let move(t, bucket, next) move a few buckets of t, if t is being
+    // migrated. move has to skip a bucket that already moved.
+    template < class Move >
+    void help_migrate(table* t, Move move) {
+        table* next = t->_next.load(std::memory_order_acquire);
+        if (!next)
+            return;
+        for (int i = 0; i < _migrate_step; ++i) {
+            std::size_t pos = t->_migrate_pos.fetch_add(1, std::memory_order_relaxed);
+            if (pos >= t->_buckets.size())
+                return;
+            move(t, t->_buckets[pos], next);
+        }
+    }
+
+    // Called once per bucket of from after it moved.
+    void bucket_moved(table* from) {
+        if (from->_moved_num.fetch_add(1, std::memory_order_acq_rel) + 1 == from->_buckets.size()) {
+            from->_next.load(std::memory_order_acquire)->_old.store(nullptr, std::memory_order_release);
+            reclaim::epoch::retire(from);
+        }
+    }
+
+    // Start migrating into a table twice as big if the newest one holds
+    // more than count items allow and no migration is running.
+    void grow_if_needed(int count) {
+        table* t = newest();
+        int bucket_size = static_cast<int>(t->_buckets.size());
+        if (count <= bucket_size * _max_load_factor ||
+            t->_old.load(std::memory_order_acquire))
+            return;
+        table* bigger = new table(bucket_size * 2 + 1, t);
+        if (!_table.compare_exchange_strong(t, bigger, std::memory_order_acq_rel)) {
+            delete bigger;
+            return;
+        }
+        // Buckets of t only start moving from here on.
+        t->_next.store(bigger, std::memory_order_release);
+    }
+};
+}// ts
@@ -0,0 +1,197 @@
+#pragma once
+
+#include <iostream>
+#include <atomic>
+#include <condition_variable>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include "ts_backoff.hpp"
+#include "ts_tuned_queue.hpp"
+#include "ts_work_stealing_deque.hpp"
+
+namespace ts {
+
+// Thread pool where every worker owns a work_stealing_deque.
+// Tasks submitted from a worker go to its own deque, tasks submitted from
+// outside go to a shared fine_tuned::queue, and an idle worker first drains
+// its own deque, then the shared queue, then steals from a random victim.
+class thread_pool {
+private:
+    // Move-only type erased callable, std::function needs copyable targets.
+    class task {
+    private:
+        struct impl_base {
+            virtual void call() = 0;
+            virtual ~impl_base() { }
+        };
+        template < class F >
+        struct impl: impl_base {
+            F _f;
+            impl(F&& f): _f(std::move(f)) { }
+            void call() override { _f(); }
+        };
+        std::unique_ptr<impl_base> _impl;
+
+    public:
+        template < class F >
+        explicit task(F&& f): _impl(new impl<F>(std::move(f))) { }
+        void operator()() { _impl->call(); }
+    };
+
+    std::atomic<bool> _done;
+    fine_tuned::queue<task*> _global_queue;
+    std::vector<std::unique_ptr<work_stealing_deque<task*>>> _queues;
+    std::vector<std::thread> _threads;
+
+    // Idle workers sleep here. A worker counts itself in _idle_num before it
+    // looks at the queues a last time, a submitter counts sleepers after it
+    // queued; both sides fence in between, so one of them sees the other.
+    std::mutex _idle_m;
+    std::condition_variable _idle_cond;
+    std::atomic<int> _idle_num;
+
+    static thread_pool*& current_pool() {
+        thread_local thread_pool* pool = nullptr;
+        return pool;
+    }
+    static std::size_t& current_index() {
+        thread_local std::size_t index = 0;
+        return index;
+    }
+
+    void worker_thread(std::size_t index) {
+        current_pool() = this;
+        current_index() = index;
+        while (!_done.load(std::memory_order_acquire)) {
+            if (run_pending_task())
+                continue;
+
+            std::unique_lock<std::mutex> l(_idle_m);
+            _idle_num.fetch_add(1, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            _idle_cond.wait(l, [this] {
+                return _done.load(std::memory_order_acquire) || has_pending_task();
+            });
+            _idle_num.fetch_sub(1, std::memory_order_relaxed);
+        }
+    }
+
+    // Called after queueing. Notifying under _idle_m makes sure a registered
+    // sleeper is already waiting, not between its last look and the wait.
+    void wake_one() {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (_idle_num.load(std::memory_order_relaxed) > 0) {
+            std::lock_guard<std::mutex> l(_idle_m);
+            _idle_cond.notify_one();
+        }
+    }
+
+    bool has_pending_task() {
+        if (!_global_queue.empty())
+            return true;
+        for (auto& q : _queues) {
+            if (!q->empty())
+                return true;
+        }
+        return false;
+    }
+
+    task* pop_task() {
+        if (current_pool() == this) {
+            if (auto item = _queues[current_index()]->pop())
+                return *item;
+        }
+
+        task* item;
+        if (_global_queue.try_pop(item))
+            return item;
+
+        std::size_t count = _queues.size();
+        std::size_t start = thread_random() % count;
+        for (std::size_t i = 0; i < count; ++i) {
+            std::size_t victim = (start + i) % count;
+            if (current_pool() == this && victim == current_index())
+                continue;
+            if (auto stolen = _queues[victim]->steal())
+                return *stolen;
+        }
+        return nullptr;
+    }
+
+public:
+    explicit thread_pool(std::size_t thread_num = std::thread::hardware_concurrency())
+        : _done(false), _idle_num(0) {
+        if (!thread_num)
+            thread_num = 1;
+        for (std::size_t i = 0; i < thread_num; ++i)
+            _queues.emplace_back(new work_stealing_deque<task*>);
+        try {
+            for (std::size_t i = 0; i < thread_num; ++i)
+                _threads.emplace_back(&thread_pool::worker_thread, this, i);
+        }
+        catch (...) {
+            {
+                std::lock_guard<std::mutex> l(_idle_m);
+                _done = true;
+            }
+            _idle_cond.notify_all();
+            for (auto& t : _threads)
+                t.join();
+            throw;
+        }
+    }
+    // Tasks that never ran are dropped, their futures report broken_promise.
+    ~thread_pool() {
+        {
+            std::lock_guard<std::mutex> l(_idle_m);
+            _done = true;
+        }
+        _idle_cond.notify_all();
+        for (auto& t : _threads)
+            t.join();
+
+        task* item;
+        while (_global_queue.try_pop(item))
+            delete item;
+        for (auto& q : _queues) {
+            while (auto stolen = q->steal())
+                delete *stolen;
+        }
+    }
+    thread_pool(const thread_pool&) = delete;
+    thread_pool& operator=(const thread_pool&) = delete;
+
+    template < class F >
+    std::future<std::invoke_result_t<F>> submit(F f) {
+        typedef std::invoke_result_t<F> result_type;
+        std::packaged_task<result_type()> work(std::move(f));
+        auto res = work.get_future();
+        task* item = new task(std::move(work));
+
+        if (current_pool() == this)
+            _queues[current_index()]->push(item);
+        else
+            _global_queue.push(item);
+        wake_one();
+        return res;
+    }
+
+    // Run one queued task on the calling thread, e.g. while waiting on a
+    // future from inside a task. Returns false if nothing was found.
+    bool run_pending_task() {
+        task* item = pop_task();
+        if (!item)
+            return false;
+        std::unique_ptr<task> owner(item);
+        (*owner)();
+        return true;
+    }
+
+    std::size_t size() const { return _threads.size(); }
+};
+}// ts
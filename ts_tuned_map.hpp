@@ -1,27 +1,49 @@
+#pragma once
+
 #include <iostream>
 #include <string>
+#include <algorithm>
+#include <atomic>
 #include <functional>
 #include <memory>
 #include <mutex>
+#include <shared_mutex>
 #include <map>
+#include <vector>
 
 #include "ts_list.hpp"
+#include "ts_reclaim.hpp"
+#include "ts_table_chain.hpp"
 
 namespace ts { namespace fine_tuned {
 
-template < class Key, class Value, class Hash = std::hash<Key>>
+// List is the bucket list, ts::list or anything with its interface.
+// Grows online through a table_chain like ts::map, see ts_table_chain.hpp.
+// Writers hold their bucket's lock shared, so they still only contend inside
+// the list; moving a bucket takes it exclusively. A moved bucket keeps its
+// (now frozen) list until the old table is reclaimed, so lookups only check
+// the bucket's _moved flag and never take the bucket lock. They still lock
+// whatever the list locks: ts::list takes a lock per node, lookups are only
+// lock-free with ts::lazy_list.
+template < class Key, class Value, class Hash = std::hash<Key>,
+           template < class > class List = list >
 class map {
 private:
     class bucket {
     private:
         typedef std::pair<Key, Value> bucket_value;
-        list<bucket_value> _list;
+        List<bucket_value> _list;
+        friend class map;
+
+        mutable std::shared_mutex _m;
+        // Items went to the next table. Only set under _m held exclusively.
+        std::atomic<bool> _moved;
 
     public:
-        bucket(): _list() {}
+        bucket(): _list(), _moved(false) {}
         bucket(const bucket& other) = delete;
         bucket& operator=(const bucket& other) = delete;
-        bucket(bucket&& other) {
+        bucket(bucket&& other): _moved(false) {
             this->_list = std::move(other._list);
         }
         bucket& operator=(bucket&& other) {
@@ -43,88 +65,201 @@ private:
             return (bool)item ? item->second : Value();
         }
 
-        void insert(const Key& key, const Value& value) {
+        // The following return the change in item count. The lists may call
+        // the predicate again when they retry, so it is only a good guess.
+        int insert(const Key& key, const Value& value) {
+            bool replaced = false;
             _list.insert(
                 [&](const bucket_value& data) {
-                    return data.first == key;
+                    return replaced = data.first == key;
                 }, bucket_value(key, value));
+            return replaced ? 0 : 1;
         }
 
-        void erase(const Key& key) {
+        int erase(const Key& key) {
+            int removed = 0;
             _list.remove_if([&](const bucket_value& data) {
-                return data.first == key;
+                bool match = data.first == key;
+                removed += match;
+                return match;
             });
+            return -removed;
+        }
+
+        int clear() {
+            int removed = 0;
+            _list.remove_if([&](const bucket_value&) {
+                ++removed;
+                return true;
+            });
+            return -removed;
         }
 
         int size() const { return _list.size(); }
-        void clear() { _list.clear(); }
         std::list<bucket_value> get_list() const { return _list.get_list(); }
     };
 
-private:
+    typedef typename table_chain<bucket>::table table;
+
     static const int _default_bucket_size = 19;
-    const int _bucket_size;
     const Hash _hash;
-    std::vector<bucket> _buckets;
+    table_chain<bucket> _tables;
+    // Approximate item count, only drives growth.
+    std::atomic<int> _count;
+
+    // Copy the items of b into to, b stays untouched for readers that are
+    // still in it. Inside an epoch guard.
+    void move_bucket(table* from, bucket& b, table* to) {
+        std::unique_lock l(b._m);
+        if (b._moved.load(std::memory_order_relaxed))
+            return;
+        for (auto& item : b.get_list()) {
+            bucket& target = to->get_bucket(_hash(item.first));
+            std::shared_lock tl(target._m);
+            target._list.push_back(item);
+        }
+        b._moved.store(true, std::memory_order_release);
+        l.unlock();
+        _tables.bucket_moved(from);
+    }
+
+    // Run f on the bucket currently holding key, without taking the bucket
+    // lock. f is only lock-free if List's lookups are (ts::lazy_list).
+    template < class Func >
+    auto read(const Key& key, Func f) const {
+        reclaim::epoch::guard guard;
+        std::size_t hash = _hash(key);
+        for (table* t = _tables.first(); ; t = t->_next.load(std::memory_order_acquire)) {
+            const bucket& b = t->get_bucket(hash);
+            if (!b._moved.load(std::memory_order_acquire))
+                return f(b);
+        }
+    }
+
+    // Run f on the bucket of key in the newest table, under a shared lock
+    // that keeps it from moving. Older buckets of key are moved on the way.
+    template < class Func >
+    void write(const Key& key, Func f) {
+        reclaim::epoch::guard guard;
+        std::size_t hash = _hash(key);
+        table* t = _tables.first();
+        _tables.help_migrate(t, [this](table* from, bucket& b, table* to) {
+            move_bucket(from, b, to);
+        });
+        while (true) {
+            bucket& b = t->get_bucket(hash);
+            std::shared_lock l(b._m);
+            if (!b._moved.load(std::memory_order_relaxed)) {
+                table* next = t->_next.load(std::memory_order_acquire);
+                if (!next) {
+                    _count.fetch_add(f(b), std::memory_order_relaxed);
+                    break;
+                }
+                l.unlock();
+                move_bucket(t, b, next);
+            }
+            t = t->_next.load(std::memory_order_acquire);
+        }
+        _tables.grow_if_needed(_count.load(std::memory_order_relaxed));
+    }
+
+    // Run f(bucket, seen) on every bucket still holding items, oldest table
+    // first, each under a shared lock. Buckets only move from older to newer
+    // tables, so no item present throughout is missed. An old bucket passed
+    // before it moved shows up again in the newer table; seen(key) tells
+    // whether key's items were already handed out that way.
+    template < class Func >
+    void for_each_bucket(Func f) const {
+        reclaim::epoch::guard guard;
+        // Per older table, which buckets were passed unmoved.
+        std::vector<std::vector<bool>> passed;
+        for (table* t = _tables.first(); t; t = t->_next.load(std::memory_order_acquire)) {
+            auto seen = [&](const Key& key) {
+                std::size_t hash = _hash(key);
+                for (auto& buckets : passed) {
+                    if (buckets[hash % buckets.size()])
+                        return true;
+                }
+                return false;
+            };
+            std::vector<bool> current(t->_buckets.size(), false);
+            for (std::size_t i = 0; i < t->_buckets.size(); ++i) {
+                bucket& b = t->_buckets[i];
+                std::shared_lock l(b._m);
+                if (!b._moved.load(std::memory_order_relaxed)) {
+                    current[i] = true;
+                    f(b, passed.empty() ? nullptr : &seen);
+                }
+            }
+            passed.push_back(std::move(current));
+        }
+    }
 
 public:
     map(
-        int bucket_size = _default_bucket_size, 
+        int bucket_size = _default_bucket_size,
         const Hash& hash = Hash())
-        : _bucket_size(bucket_size),
-          _hash(hash),
-          _buckets(_bucket_size) { }
+        : _hash(hash),
+          _tables(std::max(bucket_size, 1)),
+          _count(0) { }
     map(const map&) = delete;
     map& operator=(const map&) = delete;
 
-    bucket& get_bucket(const Key& key) {
-        return _buckets[_hash(key)%_bucket_size];
-    }
-    const bucket& get_cons_bucket(const Key& key) const {
-        return _buckets[_hash(key)%_bucket_size];
-    }
-
     bool find(const Key& key) const {
-        return get_cons_bucket(key).find(key);
+        return read(key, [&](const bucket& b) { return b.find(key); });
     }
 
     Value get(const Key& key) const {
-        return get_cons_bucket(key).get(key);
+        return read(key, [&](const bucket& b) { return b.get(key); });
     }
 
     void insert(const Key& key, const Value& value) {
-        get_bucket(key).insert(key, value);
+        write(key, [&](bucket& b) { return b.insert(key, value); });
     }
 
     void erase(const Key& key) {
-        get_bucket(key).erase(key);
+        write(key, [&](bucket& b) { return b.erase(key); });
     }
 
     int size() const {
         int size = 0;
-        for (auto it = _buckets.cbegin(); it != _buckets.cend(); ++it)
-            size += it->size();
+        for_each_bucket([&size](bucket& b, auto seen) {
+            if (!seen) {
+                size += b.size();
+                return;
+            }
+            for (auto& ele : b.get_list())
+                size += !(*seen)(ele.first);
+        });
         return size;
     }
 
     bool empty() const {
         return size() == 0;
     }
-    
+
+    int bucket_count() const {
+        reclaim::epoch::guard guard;
+        return static_cast<int>(_tables.newest()->_buckets.size());
+    }
+
     void clear() {
-        for (auto it = _buckets.begin(); it != _buckets.end(); ++it)
-            it->clear();
+        for_each_bucket([this](bucket& b, auto) {
+            _count.fetch_add(b.clear(), std::memory_order_relaxed);
+        });
     }
 
     std::map<Key, Value> get_map() const {
         std::map<Key, Value> map;
-        for (auto it = _buckets.cbegin(); it != _buckets.cend(); ++it) {
-            auto list = it->get_list();
-            for (auto& ele : list)
-                map.insert(ele);
-        }
+        for_each_bucket([&map](bucket& b, auto seen) {
+            auto list = b.get_list();
+            for (auto& ele : list) {
+                if (!seen || !(*seen)(ele.first))
+                    map.insert(ele);
+            }
+        });
         return map;
     }
 };
 }// fine_tuned
-}// ts
\ No newline at end of file
+}// ts
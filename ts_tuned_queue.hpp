@@ -1,13 +1,27 @@
 
+#pragma once
+
 #include <iostream>
 #include <queue>
 #include <mutex>
+#include <condition_variable>
 #include <memory>
+#include <atomic>
+#include <new>
+#include <chrono>
+#include <thread>
+
+#include "ts_node_pool.hpp"
+#include "ts_reclaim.hpp"
+#include "ts_counted_ptr.hpp"
+#include "ts_wait_policy.hpp"
+#include "ts_select.hpp"
 
 namespace ts { 
 namespace fine_tuned {
 
-template < class T >
+// Wait is the waiting policy of wait_and_pop, see ts_wait_policy.hpp.
+template < class T, class Wait = wait::blocking >
 class queue {
 private:
     struct node {
@@ -18,9 +32,10 @@ private:
 private:
     std::unique_ptr<node> _head;
     node* _tail;
-    std::condition_variable _cond;
+    Wait _cond;
     std::mutex _hm; // head mutex
     std::mutex _tm; // tail mutex
+    select_hook _selectors;
 
 public:
     queue(): _head(new node), _tail(_head.get()) { }
@@ -39,6 +54,38 @@ public:
             _tail = new_tail;
         }
         _cond.notify_one();
+        _selectors.notify();
+    }
+
+    // Link all items in [first, last) under a single tail lock acquisition.
+    template < class InputIt >
+    void push_range(InputIt first, InputIt last) {
+        if (first == last)
+            return;
+
+        // The current tail dummy takes the first item, the pre-built chain
+        // carries the rest and ends with the new dummy node.
+        auto first_data = std::make_shared<T>(*first++);
+        auto chain = std::make_unique<node>();
+        node* new_tail = chain.get();
+        int count = 1;
+        for (; first != last; ++first, ++count) {
+            new_tail->data = std::make_shared<T>(*first);
+            new_tail->next = std::make_unique<node>();
+            new_tail = new_tail->next.get();
+        }
+
+        {
+            std::lock_guard<std::mutex> l(_tm);
+            _tail->data = std::move(first_data);
+            _tail->next = std::move(chain);
+            _tail = new_tail;
+        }
+        if (count == 1)
+            _cond.notify_one();
+        else
+            _cond.notify_all();
+        _selectors.notify();
     }
 
     node* get_tail() {
@@ -58,6 +105,33 @@ public:
         return old_head;
     }
 
+    // Detach up to max nodes from the head, _hm must be held.
+    std::unique_ptr<node> pop_head_chain(std::size_t max, std::size_t& count) {
+        node* tail = get_tail();
+        node* last = nullptr;
+        count = 0;
+        for (node* cur = _head.get(); cur != tail && count < max; cur = cur->next.get()) {
+            last = cur;
+            ++count;
+        }
+        if (!count)
+            return nullptr;
+
+        auto chain = std::move(_head);
+        _head = std::move(last->next);
+        return chain;
+    }
+
+    // Unlink nodes one by one, see clear().
+    template < class OutputIt >
+    static void drain_chain(std::unique_ptr<node> chain, OutputIt& out) {
+        while (chain) {
+            *out++ = std::move(*chain->data);
+            auto next = std::move(chain->next);
+            chain = std::move(next);
+        }
+    }
+
     void wait_and_pop(T& data) {
         auto l = wait_item();
         data = std::move(*_head->data);
@@ -87,6 +161,43 @@ public:
         return true;
     }
 
+    // Move up to max items into out with a single head lock acquisition.
+    // Returns the number of items popped.
+    template < class OutputIt >
+    std::size_t try_pop_bulk(OutputIt out, std::size_t max) {
+        std::size_t count = 0;
+        std::unique_ptr<node> chain;
+        {
+            std::lock_guard<std::mutex> l(_hm);
+            chain = pop_head_chain(max, count);
+        }
+        drain_chain(std::move(chain), out);
+        return count;
+    }
+
+    // Block until at least one item is available, then pop up to max items.
+    // Returns 0 right away when max is 0.
+    template < class OutputIt >
+    std::size_t wait_and_pop_bulk(OutputIt out, std::size_t max) {
+        if (!max)
+            return 0;
+        std::size_t count = 0;
+        std::unique_ptr<node> chain;
+        {
+            auto l = wait_item();
+            chain = pop_head_chain(max, count);
+        }
+        drain_chain(std::move(chain), out);
+        return count;
+    }
+
+    // The waiting policy, e.g. to reach the notifier of wait::readiness.
+    Wait& wait_policy() { return _cond; }
+
+    // Registration hook for selector, s is notified after every push.
+    void attach(select_signal* s) { _selectors.attach(s); }
+    void detach(select_signal* s) { _selectors.detach(s); }
+
     bool empty() {
         std::lock_guard<std::mutex> l(_hm);
         return _head.get() == get_tail();
@@ -123,18 +234,354 @@ public:
         _head = std::move(cur);
     }
 };
+
+// Same two-lock design as queue, but T lives inline in the node and nodes
+// come from node_pool, so steady-state push/pop does not touch the global
+// allocator. Only the shared_ptr returning pops allocate.
+template < class T, class Wait = wait::blocking >
+class pooled_queue {
+private:
+    // _head is a dummy node, items live in the nodes after it.
+    struct node {
+        typename std::aligned_storage<sizeof(T), alignof(T)>::type _storage;
+        node* next;
+        node(): next(nullptr) { }
+        T* data() { return std::launder(reinterpret_cast<T*>(&_storage)); }
+    };
+    typedef node_pool<node> pool;
+
+    static node* new_node() {
+        return new (pool::allocate()) node;
+    }
+    static void delete_node(node* n) {
+        n->~node();
+        pool::deallocate(n);
+    }
+
+private:
+    node* _head;
+    node* _tail;
+    Wait _cond;
+    std::mutex _hm; // head mutex
+    std::mutex _tm; // tail mutex
+
+public:
+    pooled_queue(): _head(new_node()), _tail(_head) { }
+    ~pooled_queue() {
+        clear();
+        delete_node(_head);
+    }
+    pooled_queue(const pooled_queue&) = delete;
+    pooled_queue& operator=(const pooled_queue&) = delete;
+
+    // Nodes ever requested from the global allocator by all pooled_queue<T>.
+    static std::size_t allocated_node_num() {
+        return pool::allocated_num();
+    }
+
+    void push(T data) {
+        node* n = new_node();
+        try {
+            new (&n->_storage) T(std::move(data));
+        }
+        catch (...) {
+            delete_node(n);
+            throw;
+        }
+
+        {
+            std::lock_guard<std::mutex> l(_tm);
+            _tail->next = n;
+            _tail = n;
+        }
+        _cond.notify_one();
+    }
+
+    node* get_tail() {
+        std::lock_guard<std::mutex> l(_tm);
+        return _tail;
+    }
+
+    std::unique_lock<std::mutex> wait_item() {
+        std::unique_lock<std::mutex> l(_hm);
+        _cond.wait(l, [this] { return _head != get_tail(); });
+        return l;
+    }
+
+    // The first item node becomes the new dummy, the old dummy is returned
+    // to be released once _hm is unlocked. The item is handed out before
+    // _head moves, so a throwing assignment or allocation leaves it queued.
+    node* pop_head(T& data) {
+        node* old_head = _head;
+        data = std::move(*old_head->next->data());
+        _head = old_head->next;
+        _head->data()->~T();
+        return old_head;
+    }
+
+    node* pop_head(std::shared_ptr<T>& data) {
+        node* old_head = _head;
+        data = std::make_shared<T>(std::move(*old_head->next->data()));
+        _head = old_head->next;
+        _head->data()->~T();
+        return old_head;
+    }
+
+    void wait_and_pop(T& data) {
+        node* old_head;
+        {
+            auto l = wait_item();
+            old_head = pop_head(data);
+        }
+        delete_node(old_head);
+    }
+
+    std::shared_ptr<T> wait_and_pop() {
+        std::shared_ptr<T> data;
+        node* old_head;
+        {
+            auto l = wait_item();
+            old_head = pop_head(data);
+        }
+        delete_node(old_head);
+        return data;
+    }
+
+    std::shared_ptr<T> try_pop() {
+        std::shared_ptr<T> data;
+        node* old_head;
+        {
+            std::lock_guard<std::mutex> l(_hm);
+            if (_head == get_tail())
+                return nullptr;
+            old_head = pop_head(data);
+        }
+        delete_node(old_head);
+        return data;
+    }
+
+    bool try_pop(T& data) {
+        node* old_head;
+        {
+            std::lock_guard<std::mutex> l(_hm);
+            if (_head == get_tail())
+                return false;
+            old_head = pop_head(data);
+        }
+        delete_node(old_head);
+        return true;
+    }
+
+    // The waiting policy, e.g. to reach the notifier of wait::readiness.
+    Wait& wait_policy() { return _cond; }
+
+    bool empty() {
+        std::lock_guard<std::mutex> l(_hm);
+        return _head == get_tail();
+    }
+
+    int size() {
+        int size = 0;
+        std::scoped_lock l(_hm, _tm);
+        for (node* cur = _head; cur != _tail; cur = cur->next)
+            ++size;
+        return size;
+    }
+
+    void clear() {
+        std::scoped_lock l(_hm, _tm);
+        while (_head != _tail) {
+            node* old_head = _head;
+            _head = old_head->next;
+            _head->data()->~T();
+            delete_node(old_head);
+        }
+    }
+};
+
+// Capacity bounded variant of queue, producers block (or fail, or time out)
+// while it is full. Producers and consumers still take different locks and
+// share only the atomic item count. A side locks the other side's mutex only
+// to wake it when the queue leaves the empty or the full state; waiters wake
+// further waiters of their own side while there is room (or items) left.
+// close() wakes every waiter: pushes fail from then on, pops drain what is
+// left and fail once the queue is empty.
+template < class T >
+class bounded_queue {
+private:
+    struct node {
+        std::shared_ptr<T> data;
+        std::unique_ptr<node> next;
+    };
+
+private:
+    const std::size_t _capacity;
+    std::atomic<std::size_t> _size;
+    std::atomic<bool> _closed;
+    std::unique_ptr<node> _head;
+    node* _tail;
+    std::mutex _hm; // head mutex
+    std::mutex _tm; // tail mutex
+    std::condition_variable _not_empty; // waited on with _hm
+    std::condition_variable _not_full;  // waited on with _tm
+
+    bool can_push() const { return _closed.load() || _size.load() < _capacity; }
+    bool can_pop() const { return _closed.load() || _size.load() > 0; }
+
+    void signal_not_empty() {
+        { std::lock_guard<std::mutex> l(_hm); }
+        _not_empty.notify_one();
+    }
+
+    void signal_not_full() {
+        { std::lock_guard<std::mutex> l(_tm); }
+        _not_full.notify_one();
+    }
+
+    // wait(l) blocks on _not_full as the caller wants and returns whether the
+    // queue may have room. data is only consumed if the push succeeds.
+    template < class U, class Waiter >
+    bool push_impl(U&& data, Waiter wait) {
+        auto new_node = std::make_unique<node>();
+        node* new_tail = new_node.get();
+        std::size_t old_size;
+        {
+            std::unique_lock<std::mutex> l(_tm);
+            if (!wait(l) || _closed.load() || _size.load() >= _capacity)
+                return false;
+            _tail->data = std::make_shared<T>(std::forward<U>(data));
+            _tail->next = std::move(new_node);
+            _tail = new_tail;
+            old_size = _size.fetch_add(1);
+            if (old_size + 1 < _capacity)
+                _not_full.notify_one();
+        }
+        if (old_size == 0)
+            signal_not_empty();
+        return true;
+    }
+
+    template < class Waiter >
+    std::shared_ptr<T> pop_impl(Waiter wait) {
+        std::unique_ptr<node> old_head;
+        std::size_t old_size;
+        {
+            std::unique_lock<std::mutex> l(_hm);
+            if (!wait(l) || !_size.load())
+                return nullptr;
+            old_head = std::move(_head);
+            _head = std::move(old_head->next);
+            old_size = _size.fetch_sub(1);
+            if (old_size > 1)
+                _not_empty.notify_one();
+        }
+        if (old_size == _capacity)
+            signal_not_full();
+        return std::move(old_head->data);
+    }
+
+    static bool move_out(std::shared_ptr<T> item, T& data) {
+        if (!item)
+            return false;
+        data = std::move(*item);
+        return true;
+    }
+
+public:
+    explicit bounded_queue(std::size_t capacity)
+        : _capacity(capacity ? capacity : 1), _size(0), _closed(false),
+          _head(new node), _tail(_head.get()) { }
+    ~bounded_queue() {
+        // Unlink nodes one by one, see queue::clear().
+        while (_head) {
+            auto next = std::move(_head->next);
+            _head = std::move(next);
+        }
+    }
+    bounded_queue(const bounded_queue&) = delete;
+    bounded_queue& operator=(const bounded_queue&) = delete;
+
+    // Returns false if the queue was closed.
+    template < class U >
+    bool wait_and_push(U&& data) {
+        return push_impl(std::forward<U>(data), [this](std::unique_lock<std::mutex>& l) {
+            _not_full.wait(l, [this] { return can_push(); });
+            return true;
+        });
+    }
+
+    template < class U >
+    bool try_push(U&& data) {
+        return push_impl(std::forward<U>(data), [](std::unique_lock<std::mutex>&) { return true; });
+    }
+
+    template < class U, class Rep, class Period >
+    bool push_for(U&& data, const std::chrono::duration<Rep, Period>& timeout) {
+        return push_impl(std::forward<U>(data), [this, &timeout](std::unique_lock<std::mutex>& l) {
+            return _not_full.wait_for(l, timeout, [this] { return can_push(); });
+        });
+    }
+
+    // Returns false (nullptr) only if the queue is closed and empty.
+    bool wait_and_pop(T& data) {
+        return move_out(wait_and_pop(), data);
+    }
+
+    std::shared_ptr<T> wait_and_pop() {
+        return pop_impl([this](std::unique_lock<std::mutex>& l) {
+            _not_empty.wait(l, [this] { return can_pop(); });
+            return true;
+        });
+    }
+
+    bool try_pop(T& data) {
+        return move_out(try_pop(), data);
+    }
+
+    std::shared_ptr<T> try_pop() {
+        return pop_impl([](std::unique_lock<std::mutex>&) { return true; });
+    }
+
+    template < class Rep, class Period >
+    bool pop_for(T& data, const std::chrono::duration<Rep, Period>& timeout) {
+        return move_out(pop_for(timeout), data);
+    }
+
+    template < class Rep, class Period >
+    std::shared_ptr<T> pop_for(const std::chrono::duration<Rep, Period>& timeout) {
+        return pop_impl([this, &timeout](std::unique_lock<std::mutex>& l) {
+            return _not_empty.wait_for(l, timeout, [this] { return can_pop(); });
+        });
+    }
+
+    void close() {
+        _closed.store(true);
+        // A waiter checks _closed under its side's mutex, so after these it is
+        // either awake already or will get the notification.
+        { std::scoped_lock l(_hm, _tm); }
+        _not_empty.notify_all();
+        _not_full.notify_all();
+    }
+
+    bool closed() const { return _closed.load(); }
+
+    bool empty() const { return _size.load() == 0; }
+    int size() const { return static_cast<int>(_size.load()); }
+    std::size_t capacity() const { return _capacity; }
+};
 }// fine_tuned
 
 namespace lock_free {
 
+// Reclaimer selects how dequeued nodes are freed, see ts_reclaim.hpp.
+template < class T, class Reclaimer = reclaim::ref_count >
+class queue;
+
 template < class T >
-class queue {
+class queue<T, reclaim::ref_count> {
 private:
     struct node;
-    struct counted_node_ptr {
-        int external_count;
-        node* ptr;
-    };
+    typedef counted_ptr<node> counted_node_ptr;
     struct node_counter {
         unsigned int internal_count : 30;
         unsigned int external_counters : 2;
@@ -143,11 +590,11 @@ private:
         std::atomic<T*> _data;
         counted_node_ptr _next;
         std::atomic<node_counter> _counter;
-        node() {
+        node(): _data(nullptr) {
             node_counter counter = { 0, 2 };
             _counter.exchange(counter);
 
-            _next = { 0, nullptr };
+            _next = counted_node_ptr();
         }
         void release_ref() {
             
@@ -158,71 +605,66 @@ private:
                 --new_counter.internal_count;
             } while (!_counter.compare_exchange_strong(old_counter, new_counter));
 
-            node_counter counter = _counter.load();
-            if (!counter.external_counters && !counter.internal_count)
+            if (!new_counter.external_counters && !new_counter.internal_count)
                 delete this;
         }
     };
 
     std::atomic<counted_node_ptr> _head, _tail;
-
-    static void increase_external_count(std::atomic<counted_node_ptr>& node, counted_node_ptr& old_node) {
-
-        counted_node_ptr new_node;
-        do {
-            new_node = old_node;
-            ++new_node.external_count;
-        } while (!node.compare_exchange_strong(old_node, new_node));
-    }
+#ifndef TS_WIDE_COUNTED_PTR
+    static_assert(std::atomic<counted_node_ptr>::is_always_lock_free,
+                  "the packed counted head/tail must not fall back to libatomic locks");
+#endif
+    static_assert(std::atomic<node_counter>::is_always_lock_free,
+                  "node_counter must fit a lock-free word");
 
     static void free_external_count(const counted_node_ptr& node) {
 
-        int increase_num = node.external_count - 2;
-        node_counter old_counter = node.ptr->_counter.load();
+        int increase_num = static_cast<int>(node.count()) - 2;
+        node_counter old_counter = node.ptr()->_counter.load();
         node_counter new_counter;
         do {
             new_counter = old_counter;
             new_counter.internal_count += increase_num;
             --new_counter.external_counters;
-        } while (node.ptr->_counter.compare_exchange_strong(old_counter, new_counter));
+        } while (!node.ptr()->_counter.compare_exchange_strong(old_counter, new_counter));
 
-        node_counter counter = node.ptr->_counter.load();
-        if (!counter.external_counters && !counter.internal_count)
-            delete node.ptr;
+        if (!new_counter.external_counters && !new_counter.internal_count)
+            delete node.ptr();
     }
 
 public:
     queue() {
         node* n = new node;
-        counted_node_ptr counted_node = { 1, n };
+        counted_node_ptr counted_node(n, 1);
         _head.store(counted_node);
         _tail.store(counted_node);
     }
     ~queue() {
         while (pop()) { }
-        delete _head.load().ptr;
+        delete _head.load().ptr();
     }
 
     void push(T data) {
 
         std::unique_ptr<T> new_data = std::make_unique<T>(std::move(data));
         node* n = new node;
-        counted_node_ptr new_node = { 1, n };
+        counted_node_ptr new_node(n, 1);
 
 
         while (true) {
             counted_node_ptr old_tail = _tail.load();
-            increase_external_count(_tail, old_tail);
+            ts::increase_external_count(_tail, old_tail);
             T* old_data = nullptr;
-            if (old_tail.ptr->_data.compare_exchange_strong(old_data, new_data.get())) {
-                old_tail.ptr->_next = new_node;
+            if (old_tail.ptr()->_data.compare_exchange_strong(old_data, new_data.get())) {
+                old_tail.ptr()->_next = new_node;
                 // Get the latest tail node, which contains current external count that may change.
                 old_tail = _tail.exchange(new_node);
                 free_external_count(old_tail);
                 new_data.release();
                 break;
             }
-            old_tail.ptr->release_ref();
+            old_tail.ptr()->release_ref();
         }
     }
 
@@ -232,20 +674,114 @@ public:
 
         while (true) {
             counted_node_ptr old_head = _head.load();
-            increase_external_count(_head, old_head);
-            if (old_head.ptr == _tail.load().ptr) {
-                old_head.ptr->release_ref();
+            // Bail out before pinning the head: every pin stays in _head's
+            // count until the node is popped, so polling an empty queue
+            // would run it up without bound. Only compares addresses.
+            if (old_head.ptr() == _tail.load().ptr())
+                return std::unique_ptr<T>();
+            ts::increase_external_count(_head, old_head);
+            if (old_head.ptr() == _tail.load().ptr()) {
+                old_head.ptr()->release_ref();
                 return std::unique_ptr<T>();
             }
 
-            if (_head.compare_exchange_strong(old_head, old_head.ptr->_next)) {
-                res.reset(old_head.ptr->_data.load());
+            if (_head.compare_exchange_strong(old_head, old_head.ptr()->_next)) {
+                res.reset(old_head.ptr()->_data.load());
                 free_external_count(old_head);
                 return res;
             }
-            old_head.ptr->release_ref();
+            old_head.ptr()->release_ref();
+        }
+    }
+};
+
+// Michael-Scott queue whose dequeued nodes are handed to a guard based
+// Reclaimer (e.g. reclaim::hazard_pointer), so _head and _tail are single
+// machine words and no node carries a reference count.
+template < class T, class Reclaimer >
+class queue {
+private:
+    // _head is a dummy node, items live in the nodes after it.
+    struct node {
+        T* _data;
+        std::atomic<node*> _next;
+        node(T* data = nullptr): _data(data), _next(nullptr) { }
+    };
+
+    std::atomic<node*> _head, _tail;
+
+public:
+    queue() {
+        node* n = new node;
+        _head.store(n);
+        _tail.store(n);
+    }
+    // Make sure no thread now is accessing current queue instance
+    ~queue() {
+        node* cur = _head.load();
+        node* next = cur->_next.load();
+        delete cur;
+        while (next) {
+            cur = next;
+            next = cur->_next.load();
+            delete cur->_data;
+            delete cur;
+        }
+    }
+    queue(const queue&) = delete;
+    queue& operator=(const queue&) = delete;
+
+    void push(T data) {
+        node* n = new node(new T(std::move(data)));
+        typename Reclaimer::guard guard;
+
+        while (true) {
+            node* tail = guard.protect(_tail);
+            node* next = tail->_next.load();
+            if (tail != _tail.load())
+                continue;
+            if (next) {
+                // Help a lagging push swing the tail.
+                _tail.compare_exchange_weak(tail, next);
+                continue;
+            }
+            if (tail->_next.compare_exchange_weak(next, n)) {
+                _tail.compare_exchange_strong(tail, n);
+                return;
+            }
+        }
+    }
+
+    std::unique_ptr<T> pop() {
+        typename Reclaimer::guard guard;
+
+        while (true) {
+            node* head = guard.protect(_head, 0);
+            node* tail = _tail.load();
+            node* next = guard.protect(head->_next, 1);
+            if (head != _head.load())
+                continue;
+            if (!next)
+                return std::unique_ptr<T>();
+            if (head == tail) {
+                _tail.compare_exchange_weak(tail, next);
+                continue;
+            }
+            // Only the thread winning the CAS below takes ownership of data.
+            T* data = next->_data;
+            if (_head.compare_exchange_strong(head, next)) {
+                guard.reset(0);
+                guard.reset(1);
+                Reclaimer::retire(head);
+                return std::unique_ptr<T>(data);
+            }
         }
     }
+
+    bool empty() {
+        typename Reclaimer::guard guard;
+        return guard.protect(_head)->_next.load() == nullptr;
+    }
 };
 }
 }// ts
\ No newline at end of file
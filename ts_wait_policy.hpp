@@ -0,0 +1,124 @@
+#pragma once
+
+#include <iostream>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <type_traits>
+
+#include "ts_backoff.hpp"
+
+namespace ts {
+namespace wait {
+
+// Waiting policies for the blocking queues.
+// wait(l, p) returns with l locked once p() holds, p() is only called with l
+// locked. notify_one()/notify_all() are called by producers after publishing
+// an item, without holding l.
+
+// Park on a condition variable right away, notify unconditionally.
+class blocking {
+private:
+    std::condition_variable _cond;
+
+public:
+    template < class Lock, class Predicate >
+    void wait(Lock& l, Predicate p) {
+        _cond.wait(l, p);
+    }
+
+    void notify_one() { _cond.notify_one(); }
+    void notify_all() { _cond.notify_all(); }
+};
+
+// Spin for Spins rounds (dropping the lock and pausing between checks), then
+// park on an event count. Producers only pay for a wakeup when a consumer is
+// registered as parked. The event count uses std::atomic::wait (a futex on
+// Linux) when the library has it, a condition variable otherwise.
+template < unsigned Spins = 128 >
+class spin_then_park {
+private:
+    std::atomic<std::uint32_t> _epoch;
+    std::atomic<int> _waiters;
+#ifndef __cpp_lib_atomic_wait
+    std::mutex _m;
+    std::condition_variable _cond;
+#endif
+
+    void park(std::uint32_t epoch) {
+#ifdef __cpp_lib_atomic_wait
+        _epoch.wait(epoch, std::memory_order_seq_cst);
+#else
+        std::unique_lock<std::mutex> l(_m);
+        _cond.wait(l, [&] { return _epoch.load(std::memory_order_seq_cst) != epoch; });
+#endif
+    }
+
+    void unpark(bool all) {
+#ifdef __cpp_lib_atomic_wait
+        if (all)
+            _epoch.notify_all();
+        else
+            _epoch.notify_one();
+#else
+        // A parking thread checks the epoch under _m, so it either sees the
+        // new epoch or is already waiting when the notify is sent.
+        { std::lock_guard<std::mutex> l(_m); }
+        if (all)
+            _cond.notify_all();
+        else
+            _cond.notify_one();
+#endif
+    }
+
+    void notify(bool all) {
+        // Pairs with the fetch_add in wait(): either the producer sees the
+        // waiter, or the waiter's re-check sees the published item.
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (!_waiters.load(std::memory_order_seq_cst))
+            return;
+        _epoch.fetch_add(1, std::memory_order_seq_cst);
+        unpark(all);
+    }
+
+public:
+    spin_then_park(): _epoch(0), _waiters(0) { }
+
+    template < class Lock, class Predicate >
+    void wait(Lock& l, Predicate p) {
+        for (unsigned i = 0; i < Spins; ++i) {
+            if (p())
+                return;
+            l.unlock();
+            cpu_relax();
+            l.lock();
+        }
+
+        while (!p()) {
+            _waiters.fetch_add(1, std::memory_order_seq_cst);
+            std::uint32_t epoch = _epoch.load(std::memory_order_seq_cst);
+            if (p()) {
+                _waiters.fetch_sub(1, std::memory_order_relaxed);
+                return;
+            }
+            l.unlock();
+            park(epoch);
+            _waiters.fetch_sub(1, std::memory_order_relaxed);
+            l.lock();
+        }
+    }
+
+    void notify_one() { notify(false); }
+    void notify_all() { notify(true); }
+};
+
+// Whether Wait still wakes a waiter when the state p() reads is published
+// without holding l. blocking relies on the producer holding l.
+template < class Wait >
+struct notifies_unlocked : std::false_type { };
+
+template < unsigned Spins >
+struct notifies_unlocked<spin_then_park<Spins>> : std::true_type { };
+}// wait
+}// ts
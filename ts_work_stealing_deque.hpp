@@ -0,0 +1,137 @@
+#pragma once
+
+#include <iostream>
+#include <atomic>
+#include <memory>
+#include <vector>
+#include <optional>
+#include <cstdint>
+#include <type_traits>
+
+namespace ts {
+
+// Chase-Lev work-stealing deque.
+// The owner thread pushes and pops at the bottom without any RMW except when
+// racing a thief for the last item. Any other thread steals from the top with
+// a single CAS. The circular array grows on demand; replaced arrays are kept
+// until the deque dies because a thief may still be reading one.
+// T is read racily by thieves, so it has to be trivially copyable (usually a
+// pointer to the actual work item).
+template < class T >
+class work_stealing_deque {
+private:
+    static_assert(std::is_trivially_copyable<T>::value,
+                  "work_stealing_deque requires a trivially copyable T");
+
+    static constexpr std::size_t _cache_line_size = 64;
+
+    class array {
+    private:
+        const std::int64_t _mask;
+        std::unique_ptr<std::atomic<T>[]> _items;
+
+    public:
+        explicit array(std::int64_t capacity)
+            : _mask(capacity - 1), _items(new std::atomic<T>[capacity]) { }
+
+        std::int64_t capacity() const { return _mask + 1; }
+
+        T get(std::int64_t index) const {
+            return _items[index & _mask].load(std::memory_order_relaxed);
+        }
+
+        void put(std::int64_t index, T item) {
+            _items[index & _mask].store(item, std::memory_order_relaxed);
+        }
+
+        array* grow(std::int64_t bottom, std::int64_t top) const {
+            array* a = new array(capacity() * 2);
+            for (std::int64_t i = top; i != bottom; ++i)
+                a->put(i, get(i));
+            return a;
+        }
+    };
+
+    alignas(_cache_line_size) std::atomic<std::int64_t> _top;
+    alignas(_cache_line_size) std::atomic<std::int64_t> _bottom;
+    std::atomic<array*> _array;
+    // Owner only
+    std::vector<std::unique_ptr<array>> _arrays;
+
+public:
+    // capacity must be a power of two.
+    explicit work_stealing_deque(std::int64_t capacity = 256)
+        : _top(0), _bottom(0) {
+        _arrays.emplace_back(new array(capacity));
+        _array.store(_arrays.back().get(), std::memory_order_relaxed);
+    }
+    work_stealing_deque(const work_stealing_deque&) = delete;
+    work_stealing_deque& operator=(const work_stealing_deque&) = delete;
+
+    // Owner only
+    void push(T item) {
+        std::int64_t b = _bottom.load(std::memory_order_relaxed);
+        std::int64_t t = _top.load(std::memory_order_acquire);
+        array* a = _array.load(std::memory_order_relaxed);
+        if (b - t > a->capacity() - 1) {
+            a = a->grow(b, t);
+            _arrays.emplace_back(a);
+            _array.store(a, std::memory_order_release);
+        }
+        a->put(b, item);
+        std::atomic_thread_fence(std::memory_order_release);
+        _bottom.store(b + 1, std::memory_order_relaxed);
+    }
+
+    // Owner only
+    std::optional<T> pop() {
+        std::int64_t b = _bottom.load(std::memory_order_relaxed) - 1;
+        array* a = _array.load(std::memory_order_relaxed);
+        _bottom.store(b, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        std::int64_t t = _top.load(std::memory_order_relaxed);
+
+        if (t > b) {
+            _bottom.store(b + 1, std::memory_order_relaxed);
+            return std::nullopt;
+        }
+
+        T item = a->get(b);
+        if (t == b) {
+            // Last item, race the thieves for it.
+            bool won = _top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst,
+                                                    std::memory_order_relaxed);
+            _bottom.store(b + 1, std::memory_order_relaxed);
+            if (!won)
+                return std::nullopt;
+        }
+        return item;
+    }
+
+    // Any thread
+    std::optional<T> steal() {
+        std::int64_t t = _top.load(std::memory_order_acquire);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        std::int64_t b = _bottom.load(std::memory_order_acquire);
+        if (t >= b)
+            return std::nullopt;
+
+        array* a = _array.load(std::memory_order_acquire);
+        T item = a->get(t);
+        if (!_top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst,
+                                          std::memory_order_relaxed))
+            return std::nullopt;
+        return item;
+    }
+
+    bool empty() const {
+        return size() == 0;
+    }
+
+    int size() const {
+        std::int64_t b = _bottom.load(std::memory_order_relaxed);
+        std::int64_t t = _top.load(std::memory_order_relaxed);
+        return b > t ? static_cast<int>(b - t) : 0;
+    }
+};
+}// ts